@@ -0,0 +1,33 @@
+#!/bin/sh
+# builds tools/tables.c against the table of an older revision and against
+# this tree and runs both, then runs benchmarks/tables.ah with both.
+# REVISION is required, it is any name git understands: a tag, a branch
+# or a commit. to measure the swiss table pass the parent of the commit
+# that introduced it, git log -- table.c lists the candidates.
+#
+#   sh benchmarks/tables.sh REVISION
+set -e
+if [ $# -ne 1 ]; then
+  echo "usage: sh benchmarks/tables.sh REVISION" >&2
+  exit 64
+fi
+root=$(git rev-parse --show-toplevel)
+old=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+mkdir "$dir/old" "$dir/new"
+git -C "$root" archive "$old" | tar -x -C "$dir/old"
+cp "$root"/*.c "$root"/*.h "$dir/new"
+
+for tree in old new; do
+  cd "$dir/$tree"
+  gcc -O2 -I. "$root/tools/tables.c" $(ls *.c | grep -v '^main.c$') -o tables -lm -lpthread
+  gcc -O2 *.c -o ahadu -lm -lpthread
+done
+
+for tree in old new; do
+  echo "$tree:"
+  "$dir/$tree/tables"
+  "$dir/$tree/ahadu" "$root/benchmarks/tables.ah"
+done
@@ -24,6 +24,7 @@ typedef enum {
   OP_GREATER,
   OP_LESS,
   OP_ADD,
+  OP_CONCAT_N,
   OP_SUBTRACT,
   OP_MULTIPLY,
   OP_DIVIDE,
@@ -37,13 +38,21 @@ typedef enum {
   OP_INVOKE,
   OP_SUPER_INVOKE,
   OP_CLOSURE,
+  OP_REGION_CLOSURE,
   OP_CLOSE_UPVALUE,
+  OP_POP_REGION,
   OP_RETURN,
   OP_CLASS,
   OP_INHERIT,
   OP_METHOD
 } OpCode;
 
+// the flags of the first byte of a variable OP_CLOSURE captures.
+// a local of the enclosing function, else one of its upvalues.
+#define CAPTURE_LOCAL 0x01
+// a local that is assigned, it is shared instead of copied.
+#define CAPTURE_BOXED 0x02
+
 // a dynamic array to store some data along with the bytecode instruction
 typedef struct {
   int count; // how many in use
@@ -4,7 +4,9 @@
 
 #include "common.h"
 #include "compiler.h"
+#include "io.h"
 #include "memory.h"
+#include "number.h"
 #include "scanner.h"
 #include "object.h"
 
@@ -58,6 +60,11 @@ typedef struct
   Token name;
   int depth;
   bool isCaptured;
+  bool isAssigned;
+  // the offset of the OP_CLOSURE a local function is made by, or -1.
+  int closure;
+  // the local is used other than by calling it or passing it.
+  bool escapes;
 } Local;
 
 typedef struct
@@ -84,6 +91,15 @@ typedef struct Compiler
   int localCount;
   Upvalue upvalues[UINT8_COUNT];
   int scopeDepth;
+  // the offsets of the OP_CLOSURE captures of locals that are still in
+  // scope, an assignment may yet make them boxed.
+  int *captures;
+  int captureCount;
+  int captureCapacity;
+  // the last local that was read and whether it escaped before, an
+  // argument that is only that local does not make it escape.
+  int lastGet;
+  bool lastGetEscaped;
 } Compiler;
 
 typedef struct ClassCompiler
@@ -113,6 +129,7 @@ static void errorAt(Token *token, const wchar_t *message)
   if (parser.panicMode)
     return;
   parser.panicMode = true;
+  flushOutput();
   fwprintf(stderr, L"[መስመር %d] ላይ ስህተት", token->line);
 
   if (token->type == TOKEN_EOF)
@@ -125,10 +142,10 @@ static void errorAt(Token *token, const wchar_t *message)
   }
   else
   {
-    fwprintf(stderr, L" '%.*s' ጋ", token->length, token->start);
+    fwprintf(stderr, L" '%.*ls' ጋ", token->length, token->start);
   }
 
-  fwprintf(stderr, L": %s\n", message);
+  fwprintf(stderr, L": %ls\n", message);
   parser.hadError = true;
 }
 
@@ -265,6 +282,7 @@ static void emitReturn()
 static uint8_t makeConstant(Value value)
 {
   int constant = addConstant(currentChunk(), value);
+  writeBarrier((Obj *)current->function, value);
   if (constant > UINT8_MAX)
   {
     error(L"በ አንድ ቸንክ ውስጥ ብዙ መረጃዎች።");
@@ -307,17 +325,26 @@ static void initCompiler(Compiler *compiler, FunctionType type)
   compiler->function = NULL;
   compiler->type = type;
   compiler->localCount = 0;
+  compiler->scopeDepth = 0;
+  compiler->captures = NULL;
+  compiler->captureCount = 0;
+  compiler->captureCapacity = 0;
+  compiler->lastGet = -1;
   compiler->function = newFunction();
   current = compiler;
 
   if (type != TYPE_SCRIPT)
   {
     current->function->name = copyString(parser.previous.start, parser.previous.length);
+    writeBarrier((Obj *)current->function, OBJ_VAL(current->function->name));
   }
 
   Local *local = &current->locals[current->localCount++];
   local->depth = 0;
   local->isCaptured = false;
+  local->isAssigned = false;
+  local->closure = -1;
+  local->escapes = false;
   if (type != TYPE_FUNCTION)
   {
     local->name.start = L"ይህ";
@@ -330,13 +357,63 @@ static void initCompiler(Compiler *compiler, FunctionType type)
   }
 }
 
+/**
+ * settleCaptures - decides how the closures of the current function
+ * capture a local once no assignment to it can follow: an assigned local
+ * is boxed, the others are copied.
+ * @slot: the slot of the local, or -1 for every local.
+ */
+static void settleCaptures(int slot)
+{
+  Chunk *chunk = currentChunk();
+  int pending = 0;
+  for (int i = 0; i < current->captureCount; i++)
+  {
+    int offset = current->captures[i];
+    int index = chunk->code[offset + 1];
+    if (slot != -1 && index != slot)
+    {
+      current->captures[pending++] = offset;
+      continue;
+    }
+    if (current->locals[index].isAssigned)
+      chunk->code[offset] |= CAPTURE_BOXED;
+  }
+  current->captureCount = pending;
+}
+
+/**
+ * staysInFrame - whether a local function cannot outlive the frame that
+ * made it: it is only ever called, never captured, assigned, passed,
+ * stored or returned. it is then made in the region of the frame.
+ * @local: the local, once it went out of scope.
+ * Return: true if it cannot.
+ */
+static bool staysInFrame(Local *local)
+{
+  return local->closure != -1 && !local->isCaptured && !local->isAssigned && !local->escapes;
+}
+
 /**
  * endCompiler - ends the compiler and emits the return instruction.
  */
 static ObjFunction *endCompiler()
 {
   emitReturn();
+  settleCaptures(-1);
+  for (int i = 0; i < current->localCount; i++)
+  {
+    if (staysInFrame(&current->locals[i]))
+      currentChunk()->code[current->locals[i].closure] = OP_REGION_CLOSURE;
+  }
   ObjFunction *function = current->function;
+  for (int i = 1; i <= function->arity && i <= CALLED_PARAMS_MAX; i++)
+  {
+    Local *local = &current->locals[i];
+    if (!local->isCaptured && !local->isAssigned && !local->escapes)
+      function->calledParams |= 1u << (i - 1);
+  }
+  FREE_ARRAY(int, current->captures, current->captureCapacity);
 #ifdef DEBUG_PRINT_CODE
   if (!parser.hadError)
   {
@@ -365,7 +442,16 @@ static void endScope()
 
   while (current->localCount > 0 && current->locals[current->localCount - 1].depth > current->scopeDepth)
   {
-    if (current->locals[current->localCount - 1].isCaptured)
+    Local *local = &current->locals[current->localCount - 1];
+    if (local->isCaptured)
+      settleCaptures(current->localCount - 1);
+    if (staysInFrame(local))
+    {
+      currentChunk()->code[local->closure] = OP_REGION_CLOSURE;
+      emitByte(OP_POP_REGION);
+    }
+    // a local that is never assigned was copied into its closures.
+    else if (local->isCaptured && local->isAssigned)
     {
       emitByte(OP_CLOSE_UPVALUE);
     }
@@ -449,6 +535,21 @@ static int addUpvalue(Compiler *compiler, uint8_t index, bool isLocal)
   return compiler->function->upvalueCount++;
 }
 
+/**
+ * markAssigned - marks the local an upvalue refers to as assigned, through
+ * the functions in between.
+ * @compiler: the compiler of the upvalue.
+ * @index: the index of the upvalue.
+ */
+static void markAssigned(Compiler *compiler, int index)
+{
+  Upvalue *upvalue = &compiler->upvalues[index];
+  if (upvalue->isLocal)
+    compiler->enclosing->locals[upvalue->index].isAssigned = true;
+  else
+    markAssigned(compiler->enclosing, upvalue->index);
+}
+
 static int resolveUpvalue(Compiler *compiler, Token *name)
 {
   if (compiler->enclosing == NULL)
@@ -486,6 +587,9 @@ static void addLocal(Token name)
   local->name = name;
   local->depth = -1;
   local->isCaptured = false;
+  local->isAssigned = false;
+  local->closure = -1;
+  local->escapes = false;
 }
 
 /**
@@ -520,19 +624,83 @@ static void declareVariable()
  */
 static void number(bool canAssign)
 {
-  double value = wcstod(parser.previous.start, NULL);
+  double value;
+  parseNumber(parser.previous.start, parser.previous.length, &value);
   emitConstant(NUMBER_VAL(value));
 }
 
+/**
+ * stringText - makes the string for the text of a string literal, every $${ in
+ * it becomes ${.
+ * @chars: the text between the quotes.
+ * @length: the length of the text.
+ * Return: the string.
+ */
+static ObjString *stringText(const wchar_t *chars, int length)
+{
+  int escapes = 0;
+  for (int i = 0; i + 2 < length; i++)
+    if (chars[i] == '$' && chars[i + 1] == '$' && chars[i + 2] == '{')
+      escapes++;
+  if (escapes == 0)
+    return copyString(chars, length);
+
+  wchar_t *text = ALLOCATE(wchar_t, length - escapes + 1);
+  int count = 0;
+  for (int i = 0; i < length; i++)
+  {
+    if (chars[i] == '$' && i + 2 < length && chars[i + 1] == '$' && chars[i + 2] == '{')
+      i++;
+    text[count++] = chars[i];
+  }
+  text[count] = L'\0';
+  return takeString(text, count);
+}
+
 /**
  * string - compiles a string constant.
  */
 static void string(bool canAssign)
 {
-  emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
+  emitConstant(OBJ_VAL(stringText(parser.previous.start + 1, parser.previous.length - 2)));
 }
 
 static void expression();
+
+/**
+ * interpolation - compiles a template string. the pieces are left on the
+ * stack and joined by a single OP_CONCAT_N, empty pieces are skipped.
+ */
+static void interpolation(bool canAssign)
+{
+  int count = 0;
+  do
+  {
+    // the text between the opening " or } and the ${.
+    int length = parser.previous.length - 3;
+    if (length > 0)
+    {
+      emitConstant(OBJ_VAL(stringText(parser.previous.start + 1, length)));
+      count++;
+    }
+
+    expression();
+    count++;
+    if (count > UINT8_MAX - 1)
+      error(L"Too many pieces in a template string.");
+  } while (match(TOKEN_INTERPOLATION));
+
+  consume(TOKEN_STRING, L"Expect '}' after the expression in a template string.");
+  int length = parser.previous.length - 2;
+  if (length > 0)
+  {
+    emitConstant(OBJ_VAL(stringText(parser.previous.start + 1, length)));
+    count++;
+  }
+
+  emitBytes(OP_CONCAT_N, (uint8_t)count);
+}
+
 static void statement();
 static void declaration();
 static ParseRule *getRule(TokenType type);
@@ -581,11 +749,21 @@ static void namedVariable(Token name, bool canAssign)
 
   if (canAssign && match(TOKEN_EQUAL))
   {
+    if (setOp == OP_SET_LOCAL)
+      current->locals[arg].isAssigned = true;
+    else if (setOp == OP_SET_UPVALUE)
+      markAssigned(current, arg);
     expression();
     emitBytes(setOp, (uint8_t)arg);
   }
   else
   {
+    if (getOp == OP_GET_LOCAL && !check(TOKEN_LEFT_PAREN))
+    {
+      current->lastGet = arg;
+      current->lastGetEscaped = current->locals[arg].escapes;
+      current->locals[arg].escapes = true;
+    }
     emitBytes(getOp, (uint8_t)arg);
   }
 }
@@ -599,7 +777,9 @@ static void variable(bool canAssign)
 }
 
 /**
- * argumentList - compiles an argument list.
+ * argumentList - compiles an argument list. a local function that is
+ * passed as it is does not escape here, the vm moves it to the heap when
+ * the callee does more than call it.
  * @return: the number of arguments.
  */
 static uint8_t argumentList()
@@ -609,7 +789,11 @@ static uint8_t argumentList()
   {
     do
     {
+      int start = currentChunk()->count;
       expression();
+      uint8_t *code = currentChunk()->code + start;
+      if (currentChunk()->count == start + 2 && code[0] == OP_GET_LOCAL && code[1] == current->lastGet)
+        current->locals[current->lastGet].escapes = current->lastGetEscaped;
       if (argCount == 255)
       {
         error(L"ከ 255 በላይ የ ተግባር መለኪያዎችን መስጠት አይቻልም።");
@@ -859,6 +1043,7 @@ ParseRule rules[] = {
     [TOKEN_IDENTIFIER] = {variable, NULL, PREC_NONE},
     [TOKEN_STRING] = {string, NULL, PREC_NONE},
     [TOKEN_NUMBER] = {number, NULL, PREC_NONE},
+    [TOKEN_INTERPOLATION] = {interpolation, NULL, PREC_NONE},
     [TOKEN_AND] = {NULL, and_, PREC_AND},
     [TOKEN_CLASS] = {NULL, NULL, PREC_NONE},
     [TOKEN_ELSE] = {NULL, NULL, PREC_NONE},
@@ -978,8 +1163,9 @@ static void block()
 /**
  * function - compiles a function.
  * @type: the type of the function.
+ * Return: the offset of the OP_CLOSURE that makes it.
  */
-static void function(FunctionType type)
+static int function(FunctionType type)
 {
   Compiler compiler;
   initCompiler(&compiler, type);
@@ -1007,13 +1193,30 @@ static void function(FunctionType type)
   block();
 
   ObjFunction *function = endCompiler();
+  int closure = currentChunk()->count;
   emitBytes(OP_CLOSURE, makeConstant(OBJ_VAL(function)));
 
   for (int i = 0; i < function->upvalueCount; i++)
   {
-    emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
+    if (compiler.upvalues[i].isLocal)
+    {
+      // the flags are settled when the local goes out of scope.
+      if (current->captureCapacity < current->captureCount + 1)
+      {
+        int oldCapacity = current->captureCapacity;
+        current->captureCapacity = GROW_CAPACITY(oldCapacity);
+        current->captures = GROW_ARRAY(int, current->captures, oldCapacity, current->captureCapacity);
+      }
+      current->captures[current->captureCount++] = currentChunk()->count;
+      emitByte(CAPTURE_LOCAL);
+    }
+    else
+    {
+      emitByte(0);
+    }
     emitByte(compiler.upvalues[i].index);
   }
+  return closure;
 }
 
 static void method()
@@ -1087,7 +1290,9 @@ static void funDeclaration()
 {
   uint8_t global = parseVariable(L"የተግባር ስም ያስፈልጋል።");
   markInitialized();
-  function(TYPE_FUNCTION);
+  int closure = function(TYPE_FUNCTION);
+  if (current->scopeDepth > 0)
+    current->locals[current->localCount - 1].closure = closure;
   defineVariable(global);
 }
 
@@ -141,6 +141,8 @@ int disassembleInstruction(Chunk *chunk, int offset) {
       return simpleInstruction("OP_LESS", offset);
     case OP_ADD:
       return simpleInstruction("OP_ADD", offset);
+    case OP_CONCAT_N:
+      return byteInstruction("OP_CONCAT_N", chunk, offset);
     case OP_SUBTRACT:
       return simpleInstruction("OP_SUBTRACT", offset);
     case OP_MULTIPLY:
@@ -165,24 +167,28 @@ int disassembleInstruction(Chunk *chunk, int offset) {
       return invokeInstruction("OP_INVOKE", chunk, offset);
     case OP_SUPER_INVOKE:
       return invokeInstruction("OP_SUPER_INVOKE", chunk, offset);
-    case OP_CLOSURE: {
+    case OP_CLOSURE:
+    case OP_REGION_CLOSURE: {
+      const char *name = instruction == OP_CLOSURE ? "OP_CLOSURE" : "OP_REGION_CLOSURE";
       offset++;
       uint8_t constant = chunk->code[offset++];
-      printf("%-16s %4d ", "OP_CLOSURE", constant);
+      printf("%-16s %4d ", name, constant);
       printValue(chunk->constants.values[constant]);
       printf("\n");
 
       ObjFunction *function = AS_FUNCTION(chunk->constants.values[constant]);
       for (int j = 0; j < function->upvalueCount; j++) {
-        int isLocal = chunk->code[offset++];
+        int capture = chunk->code[offset++];
         int index = chunk->code[offset++];
         printf("%04d      |                     %s %d\n", offset - 2,
-               isLocal ? "local" : "upvalue", index);
+               capture & CAPTURE_BOXED ? "boxed" : capture & CAPTURE_LOCAL ? "local" : "upvalue", index);
       }
       return offset;
     }
     case OP_CLOSE_UPVALUE:
       return simpleInstruction("OP_CLOSE_UPVALUE", offset);
+    case OP_POP_REGION:
+      return simpleInstruction("OP_POP_REGION", offset);
     case OP_INHERIT:
       return simpleInstruction("OP_INHERIT", offset);
     case OP_CLASS:
@@ -0,0 +1,403 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wctype.h>
+
+#include "dump.h"
+#include "io.h"
+#include "memory.h"
+#include "object.h"
+#include "stats.h"
+#include "vm.h"
+
+// the characters of a string a dump keeps.
+#define DUMP_NAME_MAX 40
+
+// the names of the types in a dump, in the order of ObjType.
+static const char *typeNames[OBJ_TYPE_COUNT] = {
+  [OBJ_BOUND_METHOD] = "bound_method",
+  [OBJ_CLASS] = "class",
+  [OBJ_INSTANCE] = "instance",
+  [OBJ_LIST] = "list",
+  [OBJ_CLOSURE] = "closure",
+  [OBJ_FUNCTION] = "function",
+  [OBJ_NATIVE] = "native",
+  [OBJ_STRING] = "string",
+  [OBJ_UPVALUE] = "upvalue",
+  [OBJ_WEAK_REF] = "weak_ref",
+  [OBJ_WEAK_MAP] = "weak_map",
+};
+
+// the objects that were reached, an open addressing set of pointers.
+static Obj **seen = NULL;
+static size_t seenCount = 0;
+static size_t seenCapacity = 0;
+
+// the objects that were reached and not written yet.
+static Obj **pending = NULL;
+static size_t pendingCount = 0;
+static size_t pendingCapacity = 0;
+
+// the references of the object that is written.
+static Obj **references = NULL;
+static size_t referenceCount = 0;
+static size_t referenceCapacity = 0;
+
+static int dumpCount = 0;
+
+/**
+ * appendPointer - appends a pointer to an array of the dump, it lives
+ * outside of the heap of the collector.
+ * Return: nothing.
+ */
+static void appendPointer(Obj ***array, size_t *count, size_t *capacity, Obj *object)
+{
+  if (*capacity < *count + 1)
+  {
+    *capacity = GROW_CAPACITY(*capacity);
+    *array = (Obj **)realloc(*array, sizeof(Obj *) * *capacity);
+    if (*array == NULL)
+      exit(1);
+  }
+  (*array)[(*count)++] = object;
+}
+
+static size_t seenSlot(Obj **set, size_t capacity, Obj *object)
+{
+  uint64_t key = (uint64_t)(uintptr_t)object;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  size_t slot = key & (capacity - 1);
+  while (set[slot] != NULL && set[slot] != object)
+    slot = (slot + 1) & (capacity - 1);
+  return slot;
+}
+
+/**
+ * reach - queues an object the first time it is reached.
+ * @object: the object, or NULL.
+ * Return: nothing.
+ */
+static void reach(Obj *object)
+{
+  if (object == NULL)
+    return;
+
+  if (seenCount + 1 > seenCapacity / 2)
+  {
+    size_t capacity = seenCapacity < 1024 ? 1024 : seenCapacity * 2;
+    Obj **set = (Obj **)calloc(capacity, sizeof(Obj *));
+    if (set == NULL)
+      exit(1);
+    for (size_t i = 0; i < seenCapacity; i++)
+    {
+      if (seen[i] != NULL)
+        set[seenSlot(set, capacity, seen[i])] = seen[i];
+    }
+    free(seen);
+    seen = set;
+    seenCapacity = capacity;
+  }
+
+  size_t slot = seenSlot(seen, seenCapacity, object);
+  if (seen[slot] != NULL)
+    return;
+  seen[slot] = object;
+  seenCount++;
+  appendPointer(&pending, &pendingCount, &pendingCapacity, object);
+}
+
+/**
+ * addReference - the MoveFn a dump walks the fields of an object with,
+ * the same edges the collector traces. nothing moves.
+ * @object: the object referred to, or NULL.
+ * Return: the same object.
+ */
+static Obj *addReference(Obj *object)
+{
+  if (object != NULL)
+    appendPointer(&references, &referenceCount, &referenceCapacity, object);
+  return object;
+}
+
+/**
+ * writeChars - writes characters as UTF-8, the white space as spaces so
+ * that a record stays on one line.
+ * @file: the file.
+ * @chars: the characters.
+ * @length: the number of characters, at most DUMP_NAME_MAX are written.
+ * Return: nothing.
+ */
+static void writeChars(FILE *file, const wchar_t *chars, int length)
+{
+  char bytes[4 * DUMP_NAME_MAX];
+  wchar_t line[DUMP_NAME_MAX];
+  if (length > DUMP_NAME_MAX)
+    length = DUMP_NAME_MAX;
+  for (int i = 0; i < length; i++)
+    line[i] = iswspace(chars[i]) ? L' ' : chars[i];
+  fwrite(bytes, 1, encodeUtf8(line, length, bytes), file);
+}
+
+static void writeName(FILE *file, ObjString *name)
+{
+  if (name == NULL)
+    fputs("<script>", file);
+  else
+    writeChars(file, name->chars, name->length);
+}
+
+/**
+ * writeLabel - writes what an object is called: the characters of a
+ * string, the name of a class or function, the length of a list.
+ * @file: the file.
+ * @object: the object.
+ * Return: nothing.
+ */
+static void writeLabel(FILE *file, Obj *object)
+{
+  switch (object->type)
+  {
+  case OBJ_BOUND_METHOD:
+    writeName(file, ((ObjBoundMethod *)object)->method->function->name);
+    break;
+  case OBJ_CLASS:
+    writeName(file, ((ObjClass *)object)->name);
+    break;
+  case OBJ_CLOSURE:
+    writeName(file, ((ObjClosure *)object)->function->name);
+    break;
+  case OBJ_FUNCTION:
+    writeName(file, ((ObjFunction *)object)->name);
+    break;
+  case OBJ_INSTANCE:
+    writeName(file, ((ObjInstance *)object)->klass->name);
+    break;
+  case OBJ_LIST:
+    fprintf(file, "[%d]", ((ObjList *)object)->items.count);
+    break;
+  case OBJ_WEAK_MAP:
+    fprintf(file, "[%d]", ((ObjWeakMap *)object)->count);
+    break;
+  case OBJ_STRING:
+  {
+    ObjString *string = (ObjString *)object;
+    writeChars(file, string->chars, string->length);
+    break;
+  }
+  case OBJ_NATIVE:
+  case OBJ_UPVALUE:
+  case OBJ_WEAK_REF:
+    break;
+  }
+}
+
+/**
+ * writeRoot - writes a root record and queues the object.
+ * @file: the file.
+ * @object: the object, nothing is written for NULL.
+ * @kind: global, stack, frame, upvalue or vm.
+ * @function: the function or global the root belongs to, NULL for the
+ *            script or for none.
+ * @named: whether the label starts with the name of the function.
+ * @index: the slot the label ends with, or -1.
+ * Return: nothing.
+ */
+static void writeRoot(FILE *file, Obj *object, const char *kind,
+                      ObjString *function, bool named, int index)
+{
+  if (object == NULL)
+    return;
+  fprintf(file, "root %p %s ", (void *)object, kind);
+  if (named)
+    writeName(file, function);
+  if (index >= 0)
+    fprintf(file, named ? ":%d" : "%d", index);
+  fputc('\n', file);
+  reach(object);
+}
+
+static void writeValueRoot(FILE *file, Value value, const char *kind,
+                           ObjString *function, bool named, int index)
+{
+  if (IS_OBJ(value))
+    writeRoot(file, AS_OBJ(value), kind, function, named, index);
+}
+
+/**
+ * writeRoots - writes the roots the collector marks, with where they are
+ * held: a stack slot is labeled with its function and slot, a frame with
+ * its function and a global with its name.
+ * @file: the file.
+ * Return: nothing.
+ */
+static void writeRoots(FILE *file)
+{
+  for (int i = 0; i < vm.frameCount; i++)
+  {
+    CallFrame *frame = &vm.frames[i];
+    Value *end = i + 1 < vm.frameCount ? vm.frames[i + 1].slots : vm.stackTop;
+    ObjString *name = frame->closure->function->name;
+    for (Value *slot = frame->slots; slot < end; slot++)
+    {
+      writeValueRoot(file, *slot, "stack", name, true, (int)(slot - frame->slots));
+    }
+    writeRoot(file, (Obj *)frame->closure, "frame", name, true, -1);
+  }
+  // what is below the first frame, or everything when nothing runs.
+  Value *first = vm.frameCount > 0 ? vm.frames[0].slots : vm.stackTop;
+  for (Value *slot = vm.stack; slot < first; slot++)
+  {
+    writeValueRoot(file, *slot, "stack", NULL, false, (int)(slot - vm.stack));
+  }
+
+  for (ObjUpvalue *upvalue = vm.openUpvalues; upvalue != NULL; upvalue = upvalue->next)
+  {
+    writeRoot(file, (Obj *)upvalue, "upvalue", NULL, false, (int)(upvalue->location - vm.stack));
+  }
+
+  for (int i = 0; i <= vm.globals.capacity; i++)
+  {
+    Entry *entry = &vm.globals.entries[i];
+    if (entry->key == NULL)
+      continue;
+    writeRoot(file, (Obj *)entry->key, "global", entry->key, true, -1);
+    writeValueRoot(file, entry->value, "global", entry->key, true, -1);
+  }
+
+  if (vm.initString != NULL)
+  {
+    fprintf(file, "root %p vm initString\n", (void *)vm.initString);
+    reach((Obj *)vm.initString);
+  }
+}
+
+/**
+ * writeObject - writes the record of an object: its address, type, size
+ * with the memory it owns, the addresses it refers to separated by
+ * commas or "-" when there are none, and its label.
+ * @file: the file.
+ * @object: the object.
+ * Return: nothing.
+ */
+static void writeObject(FILE *file, Obj *object)
+{
+  referenceCount = 0;
+  moveFields(object, addReference);
+
+  fprintf(file, "object %p %s %zu ", (void *)object, typeNames[object->type],
+          objectSize(object) + ownedSize(object));
+  if (referenceCount == 0)
+    fputc('-', file);
+  for (size_t i = 0; i < referenceCount; i++)
+  {
+    fprintf(file, i == 0 ? "%p" : ",%p", (void *)references[i]);
+    reach(references[i]);
+  }
+  fputc(' ', file);
+  writeLabel(file, object);
+  fputc('\n', file);
+}
+
+/**
+ * dumpHeap - writes the objects that are alive and the references between
+ * them. the garbage is collected first, so that no cycle is marking while
+ * the fields are read. objects do not move, the addresses name them.
+ * @path: the file to write.
+ * Return: false if the file could not be written.
+ */
+bool dumpHeap(const char *path)
+{
+  collectGarbage();
+
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return false;
+
+  fputs("ahadu-heap 1\n", file);
+  writeRoots(file);
+  while (pendingCount > 0)
+  {
+    writeObject(file, pending[--pendingCount]);
+  }
+
+  free(seen);
+  free(pending);
+  free(references);
+  seen = pending = references = NULL;
+  seenCount = seenCapacity = 0;
+  pendingCapacity = referenceCapacity = 0;
+  return fclose(file) == 0;
+}
+
+static void requestDump(int signal)
+{
+  vm.heapDumpRequested = 1;
+}
+
+/**
+ * dumpRequestedHeap - writes the dump SIGUSR1 asked for, at a safepoint.
+ * the file is ahadu-<pid>-<n>.heap in the working directory.
+ * Return: nothing.
+ */
+void dumpRequestedHeap()
+{
+  vm.heapDumpRequested = 0;
+  char path[64];
+  snprintf(path, sizeof(path), "ahadu-%ld-%d.heap", (long)getpid(), ++dumpCount);
+  if (dumpHeap(path))
+    fwprintf(stderr, L"ክምሩ ወደ %s ተጽፏል።\n", path);
+  else
+    fwprintf(stderr, L"ክምሩን ወደ %s መጻፍ አልተቻለም።\n", path);
+}
+
+/**
+ * dumpHeapNative - writes a heap dump to a file.
+ * @argCount: the number of arguments.
+ * @args: the path of the file.
+ * Return: false if the path is not a string or the file could not be
+ * written.
+ */
+static bool dumpHeapNative(int argCount, Value *args)
+{
+  if (!IS_STRING(args[0]))
+  {
+    runtimeError(L"የፋይሉ ቦታ ሀረግ መሆን አለበት።");
+    return false;
+  }
+
+  ObjString *path = AS_STRING(args[0]);
+  char *utf8Path = ALLOCATE(char, 4 * path->length + 1);
+  size_t size = encodeUtf8(path->chars, path->length, utf8Path);
+  utf8Path[size] = '\0';
+  bool written = dumpHeap(utf8Path);
+  FREE_ARRAY(char, utf8Path, 4 * path->length + 1);
+
+  if (!written)
+  {
+    runtimeError(L"ፋይሉን መጻፍ አልተቻለም \"%.*ls\".", path->length, path->chars);
+    return false;
+  }
+  args[-1] = NIL_VAL;
+  return true;
+}
+
+/**
+ * initDumpNatives - defines the heap dump native and lets SIGUSR1 ask
+ * for a dump.
+ * Return: nothing.
+ */
+void initDumpNatives()
+{
+  defineNative(L"ክምር_ጻፍ", 1, dumpHeapNative);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestDump;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, NULL);
+}
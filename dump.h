@@ -0,0 +1,10 @@
+#ifndef AHADU_DUMP_H
+#define AHADU_DUMP_H
+
+#include "common.h"
+
+bool dumpHeap(const char *path);
+void dumpRequestedHeap();
+void initDumpNatives();
+
+#endif // !AHADU_DUMP_H
@@ -0,0 +1,563 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "ethiopic.h"
+#include "memory.h"
+#include "object.h"
+#include "text.h"
+#include "vm.h"
+
+#if WCHAR_MAX > 0xFFFF && defined(__AVX2__)
+#include <immintrin.h>
+#elif WCHAR_MAX > 0xFFFF && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define ETHIOPIC_FIRST 0x1200
+#define ETHIOPIC_COUNT 0x180
+#define SYLLABLE_END 0x135B
+#define IS_ETHIOPIC(c) ((uint32_t)(c) - ETHIOPIC_FIRST < ETHIOPIC_COUNT)
+
+#define NUMERAL_ONE 0x1369
+#define NUMERAL_TEN 0x1372
+#define NUMERAL_HUNDRED 0x137B
+#define NUMERAL_TEN_THOUSAND 0x137C
+
+#define LATIN_MAX 6
+
+/**
+ * Row - a consonant and its eight vowel orders.
+ * @latin: the latin consonant, the transliteration is the consonant
+ *         followed by the vowel of the order.
+ * @orders: bit i is set if order i + 1 is assigned.
+ * @oa: the eighth order is "oa" instead of "Wa".
+ */
+typedef struct
+{
+  const char *latin;
+  uint8_t orders;
+  bool oa;
+} Row;
+
+// the rows from U+1200 to U+1357, the latin letters follow SERA.
+static const Row rows[] = {
+    {"h", 0xFF, true}, {"l", 0xFF, false}, {"H", 0xFF, false}, {"m", 0xFF, false},
+    {"^s", 0xFF, false}, {"r", 0xFF, false}, {"s", 0xFF, false}, {"x", 0xFF, false},
+    {"q", 0xFF, true}, {"qW", 0x3D, false}, {"Q", 0x7F, false}, {"QW", 0x3D, false},
+    {"b", 0xFF, false}, {"v", 0xFF, false}, {"t", 0xFF, false}, {"c", 0xFF, false},
+    {"^h", 0xFF, true}, {"^hW", 0x3D, false}, {"n", 0xFF, false}, {"N", 0xFF, false},
+    {"", 0xFF, false}, {"k", 0xFF, true}, {"kW", 0x3D, false}, {"K", 0x7F, false},
+    {"KW", 0x3D, false}, {"w", 0xFF, true}, {"`", 0x7F, false}, {"z", 0xFF, false},
+    {"Z", 0xFF, false}, {"y", 0xFF, true}, {"d", 0xFF, false}, {"D", 0xFF, false},
+    {"j", 0xFF, false}, {"g", 0xFF, true}, {"gW", 0x3D, false}, {"G", 0xFF, false},
+    {"T", 0xFF, false}, {"C", 0xFF, false}, {"P", 0xFF, false}, {"S", 0xFF, false},
+    {"^S", 0xFF, true}, {"f", 0xFF, false}, {"p", 0xFF, false},
+};
+
+static const char *const vowels[] = {"e", "u", "i", "a", "E", "", "o", "Wa"};
+
+// U+1358 to U+135A do not follow the rows.
+static const char *const extraSyllables[] = {"rYa", "mYa", "fYa"};
+
+/**
+ * Syllable - what is known about a character of the ethiopic block.
+ * @family: the first order of its row, or 0 if it is not a syllable.
+ * @order: the vowel order from 1 to 8.
+ * @normal: the character that variant spellings normalize to.
+ * @latin: the transliteration, empty if it has none.
+ */
+typedef struct
+{
+  wchar_t family;
+  uint8_t order;
+  uint8_t latinLength;
+  wchar_t normal;
+  char latin[LATIN_MAX];
+} Syllable;
+
+typedef struct
+{
+  uint8_t length;
+  char latin[LATIN_MAX];
+  wchar_t syllable;
+} ReverseEntry;
+
+static Syllable syllables[ETHIOPIC_COUNT];
+
+// every transliteration, grouped by its first letter, longest first.
+static ReverseEntry reverse[ETHIOPIC_COUNT];
+static int reverseStart[129];
+
+// the characters that are written with more than one letter in amharic.
+static const struct
+{
+  wchar_t from;
+  wchar_t to;
+} variants[] = {
+    {0x1210, 0x1200}, // ሐ -> ሀ
+    {0x1280, 0x1200}, // ኀ -> ሀ
+    {0x1220, 0x1230}, // ሠ -> ሰ
+    {0x12D0, 0x12A0}, // ዐ -> አ
+    {0x1340, 0x1338}, // ፀ -> ጸ
+};
+
+static void addReverse(int *count, const char *latin, wchar_t syllable)
+{
+  ReverseEntry *entry = &reverse[(*count)++];
+  entry->length = (uint8_t)strlen(latin);
+  memcpy(entry->latin, latin, entry->length);
+  entry->syllable = syllable;
+}
+
+static int compareReverse(const void *a, const void *b)
+{
+  const ReverseEntry *x = a;
+  const ReverseEntry *y = b;
+  if (x->latin[0] != y->latin[0])
+    return (unsigned char)x->latin[0] - (unsigned char)y->latin[0];
+  if (x->length != y->length)
+    return y->length - x->length;
+  return (int)x->syllable - (int)y->syllable;
+}
+
+/**
+ * buildTables - fills the lookup tables from the rows.
+ * Return: nothing.
+ */
+static void buildTables()
+{
+  int reverseCount = 0;
+
+  for (int i = 0; i < ETHIOPIC_COUNT; i++)
+  {
+    syllables[i].normal = ETHIOPIC_FIRST + i;
+  }
+
+  for (int row = 0; row < (int)(sizeof(rows) / sizeof(rows[0])); row++)
+  {
+    for (int order = 0; order < 8; order++)
+    {
+      if ((rows[row].orders & (1 << order)) == 0)
+        continue;
+
+      wchar_t c = ETHIOPIC_FIRST + row * 8 + order;
+      Syllable *syllable = &syllables[c - ETHIOPIC_FIRST];
+      syllable->family = ETHIOPIC_FIRST + row * 8;
+      syllable->order = order + 1;
+
+      const char *vowel = order == 7 && rows[row].oa ? "oa" : vowels[order];
+      // the vowel carrier has no consonant, its sixth order is written I.
+      if (rows[row].latin[0] == '\0' && order == 5)
+        vowel = "I";
+
+      char latin[LATIN_MAX + 1];
+      strcpy(latin, rows[row].latin);
+      strcat(latin, vowel);
+      syllable->latinLength = (uint8_t)strlen(latin);
+      memcpy(syllable->latin, latin, syllable->latinLength);
+      addReverse(&reverseCount, latin, c);
+    }
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    wchar_t c = 0x1358 + i;
+    Syllable *syllable = &syllables[c - ETHIOPIC_FIRST];
+    syllable->latinLength = (uint8_t)strlen(extraSyllables[i]);
+    memcpy(syllable->latin, extraSyllables[i], syllable->latinLength);
+    addReverse(&reverseCount, extraSyllables[i], c);
+  }
+
+  for (int i = 0; i < (int)(sizeof(variants) / sizeof(variants[0])); i++)
+  {
+    for (int order = 0; order < 7; order++)
+    {
+      syllables[variants[i].from + order - ETHIOPIC_FIRST].normal = variants[i].to + order;
+    }
+  }
+  syllables[0x1227 - ETHIOPIC_FIRST].normal = 0x1237; // ሧ -> ሷ
+
+  qsort(reverse, reverseCount, sizeof(ReverseEntry), compareReverse);
+  int entry = 0;
+  for (int c = 0; c <= 128; c++)
+  {
+    while (entry < reverseCount && (unsigned char)reverse[entry].latin[0] < c)
+      entry++;
+    reverseStart[c] = entry;
+  }
+}
+
+/**
+ * normalizeChars - normalizes variant letters, the tables are read with a
+ * gather eight characters at a time when AVX2 is enabled.
+ * @chars: the characters.
+ * @length: the number of characters.
+ * @out: the destination, it can be the same as chars.
+ * Return: nothing.
+ */
+static void normalizeChars(const wchar_t *chars, int length, wchar_t *out)
+{
+  int i = 0;
+#if WCHAR_MAX > 0xFFFF && defined(__AVX2__)
+  const __m256i first = _mm256_set1_epi32(ETHIOPIC_FIRST);
+  const __m256i count = _mm256_set1_epi32(ETHIOPIC_COUNT);
+  const int *table = (const int *)&syllables[0].normal;
+  const __m256i scale = _mm256_set1_epi32(sizeof(Syllable) / sizeof(int));
+  for (; i + 8 <= length; i += 8)
+  {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(chars + i));
+    __m256i index = _mm256_sub_epi32(block, first);
+    // index < count as unsigned, negative indexes compare as large.
+    __m256i inside = _mm256_cmpgt_epi32(count, index);
+    inside = _mm256_andnot_si256(_mm256_srai_epi32(index, 31), inside);
+    if (_mm256_testz_si256(inside, inside))
+    {
+      _mm256_storeu_si256((__m256i *)(out + i), block);
+      continue;
+    }
+    __m256i offset = _mm256_mullo_epi32(index, scale);
+    __m256i mapped = _mm256_mask_i32gather_epi32(block, table, offset, inside, 4);
+    _mm256_storeu_si256((__m256i *)(out + i), mapped);
+  }
+#elif WCHAR_MAX > 0xFFFF && defined(__SSE2__)
+  // only the variant rows from U+1210 to U+1347 change.
+  const __m128i low = _mm_set1_epi32(0x1210 - 1);
+  const __m128i high = _mm_set1_epi32(0x1347 + 1);
+  for (; i + 4 <= length; i += 4)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *)(chars + i));
+    __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(block, low), _mm_cmplt_epi32(block, high));
+    if (_mm_movemask_epi8(inside) == 0)
+    {
+      _mm_storeu_si128((__m128i *)(out + i), block);
+      continue;
+    }
+    for (int j = i; j < i + 4; j++)
+    {
+      wchar_t c = chars[j];
+      out[j] = IS_ETHIOPIC(c) ? syllables[c - ETHIOPIC_FIRST].normal : c;
+    }
+  }
+#endif
+  for (; i < length; i++)
+  {
+    wchar_t c = chars[i];
+    out[i] = IS_ETHIOPIC(c) ? syllables[c - ETHIOPIC_FIRST].normal : c;
+  }
+}
+
+/**
+ * normalizeNative - spells ሐ/ኀ as ሀ, ሠ as ሰ, ዐ as አ and ፀ as ጸ in every
+ * order, the string is returned as is when nothing changes.
+ */
+static bool normalizeNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"አስተካክል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  int first = 0;
+  for (; first < string->length; first++)
+  {
+    wchar_t c = string->chars[first];
+    if (IS_ETHIOPIC(c) && syllables[c - ETHIOPIC_FIRST].normal != c)
+      break;
+  }
+  if (first == string->length)
+  {
+    args[-1] = args[0];
+    return true;
+  }
+
+  wchar_t *chars = ALLOCATE(wchar_t, string->length + 1);
+  wmemcpy(chars, string->chars, first);
+  normalizeChars(string->chars + first, string->length - first, chars + first);
+  chars[string->length] = L'\0';
+
+  args[-1] = OBJ_VAL(takeString(chars, string->length));
+  return true;
+}
+
+/**
+ * toLatinNative - transliterates the syllables of a string to latin
+ * letters, everything else is kept.
+ */
+static bool toLatinNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ወደ_ላቲን"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  size_t length = 0;
+  for (int i = 0; i < string->length; i++)
+  {
+    wchar_t c = string->chars[i];
+    int latin = IS_ETHIOPIC(c) ? syllables[c - ETHIOPIC_FIRST].latinLength : 0;
+    length += latin > 0 ? latin : 1;
+  }
+  if (length > INT32_MAX)
+  {
+    runtimeError(L"ሀረጉ በጣም ትልቅ ነው።");
+    return false;
+  }
+
+  wchar_t *chars = ALLOCATE(wchar_t, length + 1);
+  wchar_t *out = chars;
+  for (int i = 0; i < string->length; i++)
+  {
+    wchar_t c = string->chars[i];
+    const Syllable *syllable = IS_ETHIOPIC(c) ? &syllables[c - ETHIOPIC_FIRST] : NULL;
+    if (syllable == NULL || syllable->latinLength == 0)
+    {
+      *out++ = c;
+      continue;
+    }
+    for (int j = 0; j < syllable->latinLength; j++)
+      *out++ = (wchar_t)syllable->latin[j];
+  }
+  *out = L'\0';
+
+  args[-1] = OBJ_VAL(takeString(chars, (int)length));
+  return true;
+}
+
+/**
+ * fromLatinNative - transliterates latin letters back to syllables, taking
+ * the longest transliteration that matches at every position.
+ */
+static bool fromLatinNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ወደ_ግዕዝ"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  // every syllable takes at least one letter.
+  wchar_t *chars = ALLOCATE(wchar_t, string->length + 1);
+  int length = 0;
+
+  for (int i = 0; i < string->length;)
+  {
+    wchar_t c = string->chars[i];
+    const ReverseEntry *match = NULL;
+    if (c < 128)
+    {
+      for (int e = reverseStart[c]; e < reverseStart[c + 1]; e++)
+      {
+        const ReverseEntry *entry = &reverse[e];
+        if (entry->length > string->length - i)
+          continue;
+
+        int j = 1;
+        while (j < entry->length && string->chars[i + j] == (wchar_t)entry->latin[j])
+          j++;
+        if (j == entry->length)
+        {
+          match = entry;
+          break;
+        }
+      }
+    }
+
+    if (match == NULL)
+    {
+      chars[length++] = c;
+      i++;
+    }
+    else
+    {
+      chars[length++] = match->syllable;
+      i += match->length;
+    }
+  }
+  chars[length] = L'\0';
+
+  // the buffer was sized for the worst case, keep only what was used.
+  ObjString *result = copyString(chars, length);
+  FREE_ARRAY(wchar_t, chars, string->length + 1);
+  args[-1] = OBJ_VAL(result);
+  return true;
+}
+
+/**
+ * splitNative - splits a syllable into the first order of its row and its
+ * vowel order, ቡ gives [በ, 2].
+ */
+static bool splitNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ፊደል_ክፈል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  wchar_t c = string->length == 1 ? string->chars[0] : 0;
+  if (!IS_ETHIOPIC(c) || syllables[c - ETHIOPIC_FIRST].family == 0)
+  {
+    runtimeError(L"ፊደል_ክፈል አንድ የግዕዝ ፊደል ያስፈልገዋል።");
+    return false;
+  }
+
+  const Syllable *syllable = &syllables[c - ETHIOPIC_FIRST];
+  ObjList *list = newList();
+  push(OBJ_VAL(list));
+  Value family = OBJ_VAL(copyString(&syllable->family, 1));
+  push(family);
+  writeValueArray(&list->items, family);
+  writeBarrier((Obj *)list, family);
+  writeValueArray(&list->items, NUMBER_VAL(syllable->order));
+  pop();
+
+  args[-1] = pop();
+  return true;
+}
+
+/**
+ * joinNative - the syllable of a row in a vowel order, the inverse of
+ * ፊደል_ክፈል.
+ */
+static bool joinNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ፊደል_አጣምር"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  wchar_t c = string->length == 1 ? string->chars[0] : 0;
+  if (!IS_ETHIOPIC(c) || syllables[c - ETHIOPIC_FIRST].family == 0 || !IS_NUMBER(args[1]))
+  {
+    runtimeError(L"ፊደል_አጣምር የግዕዝ ፊደል እና ቁጥር ያስፈልገዋል።");
+    return false;
+  }
+
+  double order = AS_NUMBER(args[1]);
+  wchar_t family = syllables[c - ETHIOPIC_FIRST].family;
+  // NaN fails every comparison, it is turned into an int only after them.
+  if (!(order >= 1 && order <= 8) || order != (double)(int)order ||
+      syllables[family + (int)order - 1 - ETHIOPIC_FIRST].family != family)
+  {
+    runtimeError(L"የ %lc ረድፍ %g ኛ ፊደል የለውም።", family, order);
+    return false;
+  }
+  wchar_t result = family + (int)order - 1;
+
+  args[-1] = OBJ_VAL(copyString(&result, 1));
+  return true;
+}
+
+/**
+ * formatNumeralNative - writes a whole number with ethiopic numerals.
+ * the digits are taken two at a time and joined with ፻ and ፼, a ፩ in front
+ * of them is left out, 100 is ፻ and 10000 is ፼.
+ */
+static bool formatNumeralNative(int argCount, Value *args)
+{
+  if (!IS_NUMBER(args[0]))
+  {
+    runtimeError(L"ግዕዝ_ቁጥር ቁጥር ያስፈልገዋል።");
+    return false;
+  }
+
+  double number = AS_NUMBER(args[0]);
+  if (!(number >= 1 && number <= 9007199254740991.0) || number != (double)(uint64_t)number)
+  {
+    runtimeError(L"በግዕዝ መጻፍ የሚቻለው ከ 1 የሚጀምሩ ሙሉ ቁጥሮችን ብቻ ነው።");
+    return false;
+  }
+
+  uint64_t value = (uint64_t)number;
+  int pairs[10];
+  int pairCount = 0;
+  for (; value > 0; value /= 100)
+    pairs[pairCount++] = (int)(value % 100);
+
+  wchar_t chars[64];
+  int length = 0;
+  for (int i = pairCount - 1; i >= 0; i--)
+  {
+    int pair = pairs[i];
+    bool hundred = i % 2 == 1;
+    bool leading = i == pairCount - 1;
+
+    if (pair / 10 > 0)
+      chars[length++] = NUMERAL_TEN + pair / 10 - 1;
+    if (pair % 10 > 0 && !(pair == 1 && (hundred || (leading && i > 0))))
+      chars[length++] = NUMERAL_ONE + pair % 10 - 1;
+
+    if (hundred && pair > 0)
+      chars[length++] = NUMERAL_HUNDRED;
+    else if (!hundred && i > 0)
+      chars[length++] = NUMERAL_TEN_THOUSAND;
+  }
+
+  args[-1] = OBJ_VAL(copyString(chars, length));
+  return true;
+}
+
+/**
+ * parseNumeralNative - reads a number written with ethiopic numerals.
+ */
+static bool parseNumeralNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ከግዕዝ_ቁጥር"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  double total = 0; // everything before the last ፼.
+  double part = 0;  // the hundreds since then.
+  double current = 0;
+
+  for (int i = 0; i < string->length; i++)
+  {
+    wchar_t c = string->chars[i];
+    if (c >= NUMERAL_ONE && c < NUMERAL_TEN)
+    {
+      current += c - NUMERAL_ONE + 1;
+    }
+    else if (c >= NUMERAL_TEN && c < NUMERAL_HUNDRED)
+    {
+      current += 10 * (c - NUMERAL_TEN + 1);
+    }
+    else if (c == NUMERAL_HUNDRED)
+    {
+      part += (current == 0 ? 1 : current) * 100;
+      current = 0;
+    }
+    else if (c == NUMERAL_TEN_THOUSAND)
+    {
+      total += part + current;
+      total = (total == 0 ? 1 : total) * 10000;
+      part = 0;
+      current = 0;
+    }
+    else
+    {
+      runtimeError(L"'%lc' የግዕዝ ቁጥር አይደለም።", c);
+      return false;
+    }
+  }
+
+  if (string->length == 0)
+  {
+    runtimeError(L"ከግዕዝ_ቁጥር ባዶ ሀረግ ማንበብ አይችልም።");
+    return false;
+  }
+
+  args[-1] = NUMBER_VAL(total + part + current);
+  return true;
+}
+
+/**
+ * initEthiopicNatives - builds the tables and defines the ethiopic natives.
+ * Return: nothing.
+ */
+void initEthiopicNatives()
+{
+  buildTables();
+
+  defineNative(L"ፊደል_ክፈል", 1, splitNative);
+  defineNative(L"ፊደል_አጣምር", 2, joinNative);
+  defineNative(L"አስተካክል", 1, normalizeNative);
+  defineNative(L"ወደ_ላቲን", 1, toLatinNative);
+  defineNative(L"ወደ_ግዕዝ", 1, fromLatinNative);
+  defineNative(L"ግዕዝ_ቁጥር", 1, formatNumeralNative);
+  defineNative(L"ከግዕዝ_ቁጥር", 1, parseNumeralNative);
+}
@@ -0,0 +1,6 @@
+#ifndef AHADU_ETHIOPIC_H
+#define AHADU_ETHIOPIC_H
+
+void initEthiopicNatives();
+
+#endif // !AHADU_ETHIOPIC_H
@@ -0,0 +1,385 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "memory.h"
+#include "object.h"
+#include "vm.h"
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ * Output - the buffer everything አውጣ prints goes through.
+ * @fd: the file descriptor it is written to.
+ * @interactive: flush after every line, for terminals.
+ * @length: the number of bytes waiting in the buffer.
+ * @bytes: the UTF-8 encoded output.
+ */
+typedef struct
+{
+  int fd;
+  bool interactive;
+  size_t length;
+  char bytes[OUTPUT_BUFFER_SIZE];
+} Output;
+
+static Output output = {STDOUT_FILENO, true, 0, {0}};
+
+/**
+ * decodeUtf8 - decodes UTF-8 bytes into code points, without going through
+ * the locale. malformed sequences decode to U+FFFD.
+ * @bytes: the bytes to decode.
+ * @size: the number of bytes.
+ * @chars: the destination, it needs room for size characters.
+ * Return: the number of characters written.
+ */
+size_t decodeUtf8(const uint8_t *bytes, size_t size, wchar_t *chars)
+{
+  size_t length = 0;
+  size_t i = 0;
+
+  while (i < size)
+  {
+    uint8_t byte = bytes[i];
+
+    // most of a source file is ASCII, copy runs of it without branching on
+    // the sequence length.
+    if (byte < 0x80)
+    {
+      chars[length++] = byte;
+      i++;
+      continue;
+    }
+
+    int extra;
+    uint32_t codePoint;
+    uint32_t minimum;
+    if ((byte & 0xE0) == 0xC0)
+    {
+      extra = 1;
+      codePoint = byte & 0x1F;
+      minimum = 0x80;
+    }
+    else if ((byte & 0xF0) == 0xE0)
+    {
+      extra = 2;
+      codePoint = byte & 0x0F;
+      minimum = 0x800;
+    }
+    else if ((byte & 0xF8) == 0xF0)
+    {
+      extra = 3;
+      codePoint = byte & 0x07;
+      minimum = 0x10000;
+    }
+    else
+    {
+      chars[length++] = REPLACEMENT_CHARACTER;
+      i++;
+      continue;
+    }
+
+    // a sequence cut off by the end of the input stops at the end.
+    int j = 1;
+    for (; j <= extra && i + j < size; j++)
+    {
+      uint8_t continuation = bytes[i + j];
+      if ((continuation & 0xC0) != 0x80)
+        break;
+      codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+
+    if (j <= extra || codePoint < minimum || codePoint > 0x10FFFF ||
+        (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+    {
+      chars[length++] = REPLACEMENT_CHARACTER;
+      i += j;
+      continue;
+    }
+
+    chars[length++] = (wchar_t)codePoint;
+    i += extra + 1;
+  }
+
+  return length;
+}
+
+/**
+ * encodeUtf8 - encodes code points as UTF-8, without going through the
+ * locale. invalid code points encode as U+FFFD.
+ * @chars: the characters to encode.
+ * @length: the number of characters.
+ * @bytes: the destination, it needs room for 4 * length bytes.
+ * Return: the number of bytes written.
+ */
+size_t encodeUtf8(const wchar_t *chars, size_t length, char *bytes)
+{
+  uint8_t *out = (uint8_t *)bytes;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    uint32_t c = (uint32_t)chars[i];
+    if (c < 0x80)
+    {
+      *out++ = (uint8_t)c;
+      continue;
+    }
+    if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+      c = REPLACEMENT_CHARACTER;
+
+    if (c < 0x800)
+    {
+      *out++ = 0xC0 | (c >> 6);
+    }
+    else if (c < 0x10000)
+    {
+      *out++ = 0xE0 | (c >> 12);
+      *out++ = 0x80 | ((c >> 6) & 0x3F);
+    }
+    else
+    {
+      *out++ = 0xF0 | (c >> 18);
+      *out++ = 0x80 | ((c >> 12) & 0x3F);
+      *out++ = 0x80 | ((c >> 6) & 0x3F);
+    }
+    *out++ = 0x80 | (c & 0x3F);
+  }
+
+  return (size_t)(out - (uint8_t *)bytes);
+}
+
+/**
+ * initOutput - sends the output to a file descriptor. it is flushed after
+ * every line when the descriptor is a terminal, and at exit.
+ * @fd: the file descriptor.
+ * Return: nothing.
+ */
+void initOutput(int fd)
+{
+  static bool registered = false;
+
+  flushOutput();
+  output.fd = fd;
+  output.interactive = isatty(fd);
+#if defined(DEBUG_PRINT_CODE) || defined(DEBUG_TRACE_EXECUTION) || defined(DEBUG_LOG_GC)
+  // the debug logs go through stdio, keep them in order with the output.
+  output.interactive = true;
+  setvbuf(stdout, NULL, _IONBF, 0);
+#endif
+
+  if (!registered)
+  {
+    atexit(flushOutput);
+    registered = true;
+  }
+}
+
+/**
+ * writeAll - writes bytes to the output file descriptor.
+ * @bytes: the bytes.
+ * @length: the number of bytes.
+ * Return: nothing.
+ */
+static void writeAll(const char *bytes, size_t length)
+{
+  size_t written = 0;
+  while (written < length)
+  {
+    ssize_t result = write(output.fd, bytes + written, length - written);
+    if (result < 0 && errno == EINTR)
+      continue;
+    // the reader is gone, there is nobody to report it to.
+    if (result <= 0)
+      break;
+    written += (size_t)result;
+  }
+}
+
+/**
+ * flushOutput - writes out the buffered output.
+ * Return: nothing.
+ */
+void flushOutput()
+{
+  writeAll(output.bytes, output.length);
+  output.length = 0;
+}
+
+/**
+ * writeOutput - buffers bytes for the output, writes bigger than the buffer
+ * go out directly.
+ * @bytes: the bytes.
+ * @length: the number of bytes.
+ * Return: nothing.
+ */
+void writeOutput(const char *bytes, size_t length)
+{
+  if (output.length + length > OUTPUT_BUFFER_SIZE)
+  {
+    flushOutput();
+    if (length > OUTPUT_BUFFER_SIZE)
+    {
+      writeAll(bytes, length);
+      return;
+    }
+  }
+
+  memcpy(output.bytes + output.length, bytes, length);
+  output.length += length;
+}
+
+/**
+ * writeOutputText - buffers a null terminated string for the output.
+ * @text: the string.
+ * Return: nothing.
+ */
+void writeOutputText(const char *text)
+{
+  writeOutput(text, strlen(text));
+}
+
+/**
+ * writeOutputChars - encodes characters as UTF-8 straight into the output
+ * buffer.
+ * @chars: the characters.
+ * @length: the number of characters.
+ * Return: nothing.
+ */
+void writeOutputChars(const wchar_t *chars, size_t length)
+{
+  while (length > 0)
+  {
+    size_t room = (OUTPUT_BUFFER_SIZE - output.length) / 4;
+    if (room == 0)
+    {
+      flushOutput();
+      continue;
+    }
+
+    size_t count = length < room ? length : room;
+    output.length += encodeUtf8(chars, count, output.bytes + output.length);
+    chars += count;
+    length -= count;
+  }
+}
+
+/**
+ * endOutputLine - ends a line of output, the line is written right away
+ * when the output is interactive.
+ * Return: nothing.
+ */
+void endOutputLine()
+{
+  writeOutput("\n", 1);
+  if (output.interactive)
+    flushOutput();
+}
+
+/**
+ * mapFile - maps a UTF-8 file and decodes it straight into a read-only
+ * region, the file is read once and never copied through stdio.
+ * @path: the path of the file.
+ * @length: where the number of decoded characters is written.
+ * Return: the characters, or NULL if the file could not be read.
+ */
+static wchar_t *mapFile(const char *path, int *length)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) == -1 || (size_t)info.st_size >= INT_MAX)
+  {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)info.st_size;
+
+  const uint8_t *bytes = NULL;
+  if (size > 0)
+  {
+    bytes = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (bytes == MAP_FAILED)
+    {
+      close(fd);
+      return NULL;
+    }
+    madvise((void *)bytes, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  // every byte decodes to at most one character.
+  size_t capacity = sizeof(wchar_t) * (size + 1);
+  wchar_t *chars = (wchar_t *)mapPages(capacity);
+  if (chars == NULL)
+  {
+    if (bytes != NULL)
+      munmap((void *)bytes, size);
+    return NULL;
+  }
+
+  size_t count = size > 0 ? decodeUtf8(bytes, size, chars) : 0;
+  chars[count] = L'\0';
+  if (bytes != NULL)
+    munmap((void *)bytes, size);
+
+  // give back the pages that multi-byte sequences left unused.
+  size_t used = pageRound(sizeof(wchar_t) * (count + 1));
+  size_t mapped = pageRound(capacity);
+  if (used < mapped)
+    unmapPages((char *)chars + used, mapped - used);
+
+  mprotect(chars, used, PROT_READ);
+  *length = (int)count;
+  return chars;
+}
+
+/**
+ * readFileNative - reads a whole UTF-8 file into a string.
+ * the characters live in a read-only mapping and substrings of the result
+ * point into it instead of copying.
+ */
+static bool readFileNative(int argCount, Value *args)
+{
+  if (!IS_STRING(args[0]))
+  {
+    runtimeError(L"የፋይሉ ቦታ ሀረግ መሆን አለበት።");
+    return false;
+  }
+
+  ObjString *path = AS_STRING(args[0]);
+  char *utf8Path = ALLOCATE(char, 4 * path->length + 1);
+  size_t size = encodeUtf8(path->chars, path->length, utf8Path);
+  utf8Path[size] = '\0';
+
+  int length;
+  wchar_t *chars = mapFile(utf8Path, &length);
+  FREE_ARRAY(char, utf8Path, 4 * path->length + 1);
+
+  if (chars == NULL)
+  {
+    runtimeError(L"ፋይሉን ማንበብ አልተቻለም \"%.*ls\".", path->length, path->chars);
+    return false;
+  }
+
+  args[-1] = OBJ_VAL(takeMappedString(chars, length));
+  return true;
+}
+
+/**
+ * initIoNatives - defines the file natives.
+ * Return: nothing.
+ */
+void initIoNatives()
+{
+  defineNative(L"ፋይል_አንብብ", 1, readFileNative);
+}
@@ -0,0 +1,18 @@
+#ifndef AHADU_IO_H
+#define AHADU_IO_H
+
+#include <wchar.h>
+
+#include "common.h"
+
+size_t decodeUtf8(const uint8_t *bytes, size_t size, wchar_t *chars);
+size_t encodeUtf8(const wchar_t *chars, size_t length, char *bytes);
+void initOutput(int fd);
+void flushOutput();
+void writeOutput(const char *bytes, size_t length);
+void writeOutputText(const char *text);
+void writeOutputChars(const wchar_t *chars, size_t length);
+void endOutputLine();
+void initIoNatives();
+
+#endif // !AHADU_IO_H
@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "large.h"
+
+/**
+ * LargeRegion - a freed mapping whose pages were given back to the
+ * kernel, it is only address space until it is used again.
+ * @start: the start of the mapping.
+ * @size: the size of the mapping, a whole number of pages.
+ */
+typedef struct
+{
+  void *start;
+  size_t size;
+} LargeRegion;
+
+static LargeRegion cache[LARGE_CACHE_REGIONS];
+static int cachedCount = 0;
+
+/**
+ * pageRound - rounds a size up to a whole number of pages.
+ * @size: the size in bytes.
+ * Return: the rounded size.
+ */
+size_t pageRound(size_t size)
+{
+  static size_t pageSize = 0;
+  if (pageSize == 0)
+    pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  return (size + pageSize - 1) & ~(pageSize - 1);
+}
+
+/**
+ * takeCached - takes the smallest cached mapping that is big enough, the
+ * pages past the size are unmapped.
+ * @size: the size, a whole number of pages.
+ * Return: the mapping, or NULL if none is big enough.
+ */
+static void *takeCached(size_t size)
+{
+  int best = -1;
+  for (int i = 0; i < cachedCount; i++)
+  {
+    if (cache[i].size >= size && (best < 0 || cache[i].size < cache[best].size))
+      best = i;
+  }
+  if (best < 0)
+    return NULL;
+
+  LargeRegion region = cache[best];
+  cache[best] = cache[--cachedCount];
+  if (region.size > size)
+    munmap((char *)region.start + size, region.size - size);
+  return region.start;
+}
+
+/**
+ * allocateLarge - maps pages for a large block, outside of the malloc
+ * heap. the pages are zero until they are written.
+ * @size: the size in bytes, it is rounded up to whole pages.
+ * Return: the block, or NULL if the kernel refused.
+ */
+void *allocateLarge(size_t size)
+{
+  size = pageRound(size);
+  void *result = takeCached(size);
+  if (result != NULL)
+    return result;
+
+  result = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return result == MAP_FAILED ? NULL : result;
+}
+
+/**
+ * resizeLarge - resizes a large block. the kernel moves the pages, the
+ * contents are not copied.
+ * @pointer: the block.
+ * @oldSize: the size the block was allocated with.
+ * @newSize: the new size.
+ * Return: the block, or NULL if the kernel refused.
+ */
+void *resizeLarge(void *pointer, size_t oldSize, size_t newSize)
+{
+  oldSize = pageRound(oldSize);
+  newSize = pageRound(newSize);
+  if (oldSize == newSize)
+    return pointer;
+
+#ifdef __linux__
+  void *result = mremap(pointer, oldSize, newSize, MREMAP_MAYMOVE);
+  return result == MAP_FAILED ? NULL : result;
+#else
+  void *result = allocateLarge(newSize);
+  if (result == NULL)
+    return NULL;
+  memcpy(result, pointer, oldSize < newSize ? oldSize : newSize);
+  freeLarge(pointer, oldSize);
+  return result;
+#endif
+}
+
+/**
+ * freeLarge - gives the pages of a large block back to the kernel. the
+ * mapping is kept to be used again, unless the cache is full. it is made
+ * writable again first, ፋይል_አንብብ leaves its pages read-only.
+ * @pointer: the block, or a whole number of pages at its end.
+ * @size: the size the block was allocated with.
+ * Return: nothing.
+ */
+void freeLarge(void *pointer, size_t size)
+{
+  size = pageRound(size);
+  if (cachedCount == LARGE_CACHE_REGIONS)
+  {
+    munmap(pointer, size);
+    return;
+  }
+  if (mprotect(pointer, size, PROT_READ | PROT_WRITE) != 0)
+  {
+    munmap(pointer, size);
+    return;
+  }
+  madvise(pointer, size, MADV_DONTNEED);
+  cache[cachedCount].start = pointer;
+  cache[cachedCount].size = size;
+  cachedCount++;
+}
+
+/**
+ * freeLargeCache - unmaps the cached mappings.
+ * Return: nothing.
+ */
+void freeLargeCache()
+{
+  while (cachedCount > 0)
+  {
+    cachedCount--;
+    munmap(cache[cachedCount].start, cache[cachedCount].size);
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef AHADU_LARGE_H
+#define AHADU_LARGE_H
+
+#include "common.h"
+
+// a block this big is mapped on its own pages instead of taken from malloc.
+#define LARGE_OBJECT_SIZE (64 * 1024)
+// the freed mappings that are kept to be mapped again.
+#define LARGE_CACHE_REGIONS 16
+
+size_t pageRound(size_t size);
+void *allocateLarge(size_t size);
+void *resizeLarge(void *pointer, size_t oldSize, size_t newSize);
+void freeLarge(void *pointer, size_t size);
+void freeLargeCache();
+
+#endif // !AHADU_LARGE_H
@@ -4,19 +4,25 @@
 #include <wctype.h>
 #include <wchar.h>
 #include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "chunk.h"
 #include "debug.h"
+#include "io.h"
+#include "profile.h"
+#include "stats.h"
 #include "vm.h"
 
 static void repl() {
   wchar_t line[1024];
   for (;;) {
-    printf("> ");
+    writeOutputText("> ");
+    flushOutput();
 
     if (!fgetws(line, sizeof(line), stdin)) {
-      printf("\n");
+      endOutputLine();
       break;
     }
     interpret(line);
@@ -62,13 +68,168 @@ static wchar_t *readFile(const char *path) {
   return wideBuffer;
 }
 
-static void runFile(const char *path) {
+/**
+ * parseOutputFd - reads the file descriptor given to --output-fd.
+ * @text: the argument.
+ * Return: the file descriptor, the program exits if it is not open.
+ */
+static int parseOutputFd(const char *text) {
+  char *end;
+  long fd = strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || fd < 0 || fd > INT32_MAX ||
+      fcntl((int)fd, F_GETFD) == -1) {
+    fprintf(stderr, "የውጤት ፋይል መግለጫው \"%s\" አልተከፈተም።\n", text);
+    exit(64);
+  }
+  return (int)fd;
+}
+
+/**
+ * parsePauseBudget - reads the microseconds given to --gc-pause-us.
+ * @text: the argument.
+ * Return: the budget in nanoseconds, the program exits if it is not a number.
+ */
+static uint64_t parsePauseBudget(const char *text) {
+  char *end;
+  long micros = strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || micros < 0 || micros > INT32_MAX) {
+    fprintf(stderr, "የማቆሚያ ጊዜው \"%s\" ቁጥር አይደለም።\n", text);
+    exit(64);
+  }
+  return (uint64_t)micros * 1000;
+}
+
+/**
+ * parseHeapSize - reads a heap size in bytes, a k, m or g after the
+ * number multiplies it by 1024, 1024² or 1024³.
+ * @text: the argument.
+ * Return: the size, the program exits if it is not a size.
+ */
+static size_t parseHeapSize(const char *text) {
+  char *end;
+  unsigned long long size = strtoull(text, &end, 10);
+  unsigned shift = 0;
+  switch (*end) {
+  case 'k': case 'K': shift = 10; end++; break;
+  case 'm': case 'M': shift = 20; end++; break;
+  case 'g': case 'G': shift = 30; end++; break;
+  }
+  if (*text < '0' || *text > '9' || *end != '\0' || size > (SIZE_MAX >> shift)) {
+    fprintf(stderr, "የክምር መጠኑ \"%s\" ትክክል አይደለም።\n", text);
+    exit(64);
+  }
+  return (size_t)size << shift;
+}
+
+/**
+ * parseGrowth - reads how much the heap may grow between collections.
+ * @text: the argument.
+ * Return: the factor, the program exits if it is not a number above 1.
+ */
+static double parseGrowth(const char *text) {
+  char *end;
+  double growth = strtod(text, &end);
+  if (*text == '\0' || *end != '\0' || !(growth > 1.0 && growth < 1000.0)) {
+    fprintf(stderr, "የዕድገት መጠኑ \"%s\" ከ1 የሚበልጥ ቁጥር አይደለም።\n", text);
+    exit(64);
+  }
+  return growth;
+}
+
+typedef enum {
+  OPTION_INITIAL_HEAP,
+  OPTION_MIN_HEAP,
+  OPTION_MAX_HEAP,
+  OPTION_GROWTH,
+  OPTION_PAUSE,
+  OPTION_COUNT,
+} GcOptionKind;
+
+/**
+ * GcOption - a setting of the collector, read from the environment. the
+ * flag overrides it.
+ * @flag: the flag.
+ * @variable: the environment variable.
+ * @value: the text that was given, or NULL.
+ */
+typedef struct {
+  const char *flag;
+  const char *variable;
+  const char *value;
+} GcOption;
+
+static GcOption gcOptions[OPTION_COUNT] = {
+  [OPTION_INITIAL_HEAP] = {"--gc-initial-heap", "AHADU_GC_INITIAL_HEAP", NULL},
+  [OPTION_MIN_HEAP] = {"--gc-min-heap", "AHADU_GC_MIN_HEAP", NULL},
+  [OPTION_MAX_HEAP] = {"--gc-max-heap", "AHADU_GC_MAX_HEAP", NULL},
+  [OPTION_GROWTH] = {"--gc-growth", "AHADU_GC_GROWTH", NULL},
+  [OPTION_PAUSE] = {"--gc-pause-us", "AHADU_GC_PAUSE_US", NULL},
+};
+
+/**
+ * readGcOption - reads a collector flag and its value.
+ * @argc: argument count.
+ * @argv: the arguments.
+ * @arg: the index of the flag, moved to its value.
+ * Return: true if it was a collector flag.
+ */
+static bool readGcOption(int argc, const char *argv[], int *arg) {
+  if (*arg + 1 >= argc) return false;
+  for (int i = 0; i < OPTION_COUNT; i++) {
+    if (strcmp(argv[*arg], gcOptions[i].flag) == 0) {
+      gcOptions[i].value = argv[++*arg];
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * applyGcOptions - sets up the collector from the environment and the
+ * flags. the first collection starts at the initial heap, kept between
+ * the minimum and the limit.
+ * Return: nothing.
+ */
+static void applyGcOptions() {
+  const char *values[OPTION_COUNT];
+  for (int i = 0; i < OPTION_COUNT; i++) {
+    values[i] = gcOptions[i].value != NULL ? gcOptions[i].value
+                                           : getenv(gcOptions[i].variable);
+  }
+
+  if (values[OPTION_PAUSE] != NULL)
+    vm.gcPauseBudget = parsePauseBudget(values[OPTION_PAUSE]);
+  if (values[OPTION_GROWTH] != NULL)
+    vm.gcGrowthFactor = parseGrowth(values[OPTION_GROWTH]);
+  if (values[OPTION_MIN_HEAP] != NULL)
+    vm.gcMinHeap = parseHeapSize(values[OPTION_MIN_HEAP]);
+  if (values[OPTION_MAX_HEAP] != NULL)
+    vm.gcMaxHeap = parseHeapSize(values[OPTION_MAX_HEAP]);
+  if (vm.gcMaxHeap != 0 && vm.gcMinHeap > vm.gcMaxHeap) {
+    fprintf(stderr, "ትንሹ ክምር ከክምሩ ገደብ ይበልጣል።\n");
+    exit(64);
+  }
+
+  if (values[OPTION_INITIAL_HEAP] != NULL)
+    vm.nextGC = parseHeapSize(values[OPTION_INITIAL_HEAP]);
+  if (vm.nextGC < vm.gcMinHeap) vm.nextGC = vm.gcMinHeap;
+  if (vm.gcMaxHeap != 0 && vm.nextGC > vm.gcMaxHeap) vm.nextGC = vm.gcMaxHeap;
+}
+
+/**
+ * runFile - runs a file.
+ * @path: the path of the file.
+ * Return: the exit status, 65 for a compile error and 60 for a runtime
+ * error.
+ */
+static int runFile(const char *path) {
   wchar_t *source = readFile(path);
   InterpretResult result = interpret(source);
   free(source);
 
-  if (result == INTERPRET_COMPILE_ERROR) exit(65);
-  if (result == INTERPRET_RUNTIME_ERROR) exit(60);
+  if (result == INTERPRET_COMPILE_ERROR) return 65;
+  if (result == INTERPRET_RUNTIME_ERROR) return 60;
+  return 0;
 }
 /**
  * main - entry point for ahadu.
@@ -79,17 +240,63 @@ static void runFile(const char *path) {
 int main(int argc, const char *argv[])
 {
   setlocale(LC_ALL, "");
+
+  int arg = 1;
+  int outputFd = STDOUT_FILENO;
+  bool concurrent = false;
+  bool compact = false;
+  bool gcStats = false;
+  const char *profilePath = NULL;
+  size_t profileSample = PROFILE_SAMPLE_BYTES;
+  for (; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--gc-concurrent") == 0) {
+      concurrent = true;
+    } else if (strcmp(argv[arg], "--gc-compact") == 0) {
+      compact = true;
+    } else if (strcmp(argv[arg], "--gc-stats") == 0) {
+      gcStats = true;
+    } else if (arg + 1 < argc && strcmp(argv[arg], "--alloc-profile") == 0) {
+      profilePath = argv[++arg];
+    } else if (arg + 1 < argc && strcmp(argv[arg], "--alloc-sample") == 0) {
+      profileSample = parseHeapSize(argv[++arg]);
+      if (profileSample == 0) {
+        fprintf(stderr, "የናሙናው መጠን ከ0 መብለጥ አለበት።\n");
+        exit(64);
+      }
+    } else if (arg + 1 < argc && strcmp(argv[arg], "--output-fd") == 0) {
+      outputFd = parseOutputFd(argv[++arg]);
+    } else if (readGcOption(argc, argv, &arg)) {
+      continue;
+    } else {
+      break;
+    }
+  }
+  initOutput(outputFd);
   initVM();
+  applyGcOptions();
+  vm.gcConcurrent = concurrent;
+  vm.gcCompact = compact;
+  if (profilePath != NULL) startProfile(profileSample);
 
-  if (argc == 1) {
+  int status = 0;
+  if (argc == arg) {
     repl();
-  } else if (argc == 2) {
-    runFile(argv[1]);
+  } else if (argc == arg + 1) {
+    status = runFile(argv[arg]);
   } else {
-    fprintf(stderr, "አጠቃቀም: ahadu [የፋይል ቦታ]\n");
+    fprintf(stderr, "አጠቃቀም: ahadu [--output-fd N] [--gc-pause-us N] [--gc-initial-heap N] [--gc-min-heap N] [--gc-max-heap N] [--gc-growth N] [--gc-concurrent] [--gc-compact] [--gc-stats] [--alloc-profile ፋይል] [--alloc-sample N] [የፋይል ቦታ]\n");
     exit(64);
   }
 
+  if (gcStats) {
+    flushOutput();
+    printGcStats(stderr);
+  }
+  if (profilePath != NULL && !writeProfile(profilePath)) {
+    fwprintf(stderr, L"የመገለጫ ፋይሉን \"%s\" መጻፍ አልተቻለም።\n", profilePath);
+    if (status == 0) status = 74;
+  }
+  if (status != 0) exit(status);
   freeVM();
   return 0;
 }
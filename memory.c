@@ -1,15 +1,172 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <string.h>
+#include <time.h>
 
 #include "compiler.h"
 #include "memory.h"
+#include "profile.h"
+#include "slab.h"
 #include "vm.h"
+#include "weak.h"
 
 #ifdef DEBUG_LOG_GC
-#include <stdio.h>
 #include "debug.h"
 #endif
 
-#define GC_HEAP_GROW_FACTOR 2
+#define GC_HEAP_GROW_FACTOR 2.0
+#define GC_INITIAL_HEAP (1024 * 1024)
+// the bytes allocated between two marking steps.
+#define GC_STEP_BYTES (64 * 1024)
+// the objects blackened between two looks at the clock.
+#define GC_STEP_OBJECTS 64
+// the large object space starts a cycle once it grows past this.
+#define GC_LARGE_MIN_BYTES (16 * 1024 * 1024)
+// the smallest heap that is compacted when it is fragmented.
+#define GC_COMPACT_MIN_BYTES (1024 * 1024)
+
+static bool collecting = false;
+
+// the background marker. it blackens objects while holding gcLock, the
+// mutator takes the lock to move or free what the marker may be reading.
+static pthread_t marker;
+static pthread_mutex_t gcLock;
+static pthread_cond_t grayReady;
+static bool markerStarted = false;
+static bool markerQuit = false;
+
+// the weak refs and weak maps a cycle blackened, their slots are looked at
+// once marking is done. the marker adds to it while holding gcLock.
+static Obj **weakObjects = NULL;
+static int weakCount = 0;
+static int weakCapacity = 0;
+
+// the weak refs and weak maps a young collection reached.
+static Obj **youngWeak = NULL;
+static int youngWeakCount = 0;
+static int youngWeakCapacity = 0;
+
+// the objects promote() copied, it tells when promoting settled.
+static size_t promotions = 0;
+
+static void stepGarbage();
+
+/**
+ * gcDue - whether an allocation owes the collector work. the large object
+ * space has its own threshold, so a few big blocks do not put off the
+ * collection of many small ones.
+ * Return: true if a cycle should start or a step should run.
+ */
+static inline bool gcDue()
+{
+  if (vm.gcPhase != GC_IDLE)
+    return vm.bytesAllocated > vm.nextStep;
+  return vm.bytesAllocated > vm.nextGC || vm.largeBytes > vm.nextLargeGC;
+}
+
+/**
+ * heapSize - the bytes of both spaces, what the heap limit is compared to.
+ * Return: the size.
+ */
+static inline size_t heapSize()
+{
+  return vm.bytesAllocated + vm.largeBytes;
+}
+
+/**
+ * checkHeapLimit - collects all the garbage in one pause once the heap
+ * grows past its limit. if it is still too big a runtime error is raised
+ * at the next safepoint, the allocation itself goes through since the C
+ * code that asked for it can not fail.
+ * Return: nothing.
+ */
+static void checkHeapLimit()
+{
+  if (vm.gcMaxHeap == 0 || vm.heapExhausted || heapSize() <= vm.gcMaxHeap)
+    return;
+  collectGarbage();
+  if (heapSize() > vm.gcMaxHeap)
+    vm.heapExhausted = true;
+}
+
+/**
+ * heapLimitReached - collects the garbage again at a safepoint, the
+ * program may have dropped what filled the heap since the limit was
+ * passed.
+ * Return: true if the heap is still past its limit.
+ */
+bool heapLimitReached()
+{
+  vm.heapExhausted = false;
+  collectGarbage();
+  return heapSize() > vm.gcMaxHeap;
+}
+
+/**
+ * countBytes - moves the size of a block from one space to the other
+ * when it crosses LARGE_OBJECT_SIZE.
+ * @oldSize: the old size of the block.
+ * @newSize: the new size of the block.
+ * Return: nothing.
+ */
+static void countBytes(size_t oldSize, size_t newSize)
+{
+  if (oldSize >= LARGE_OBJECT_SIZE)
+    vm.largeBytes -= pageRound(oldSize);
+  else
+    vm.bytesAllocated -= oldSize;
+  if (newSize >= LARGE_OBJECT_SIZE)
+    vm.largeBytes += pageRound(newSize);
+  else
+    vm.bytesAllocated += newSize;
+}
+
+/**
+ * resizeBlock - resizes a block with malloc, or in the large object space
+ * when it is large.
+ * @pointer: the block, or NULL.
+ * @oldSize: the old size of the block.
+ * @newSize: the new size of the block.
+ * Return: the block, or NULL when the size is zero or memory ran out.
+ */
+static void *resizeBlock(void *pointer, size_t oldSize, size_t newSize)
+{
+  bool wasLarge = oldSize >= LARGE_OBJECT_SIZE;
+  bool isLarge = newSize >= LARGE_OBJECT_SIZE;
+  if (wasLarge && isLarge)
+    return resizeLarge(pointer, oldSize, newSize);
+
+  if (isLarge)
+  {
+    void *result = allocateLarge(newSize);
+    if (result != NULL && pointer != NULL)
+      memcpy(result, pointer, oldSize);
+    free(pointer);
+    return result;
+  }
+
+  if (wasLarge)
+  {
+    void *result = newSize == 0 ? NULL : malloc(newSize);
+    if (result != NULL)
+      memcpy(result, pointer, newSize);
+    freeLarge(pointer, oldSize);
+    return result;
+  }
+
+  if (newSize == 0)
+  {
+    free(pointer);
+    return NULL;
+  }
+  // realloc handles the rest, if newSize is > oldSize it grows the size of the arrray otherwise it shrinks it.
+  return realloc(pointer, newSize);
+}
 
 /**
  * reallocate - handles the realocation of a dynamic array.
@@ -20,37 +177,743 @@
  */
 void *reallocate(void *pointer, size_t oldSize, size_t newSize)
 {
-  vm.bytesAllocated += newSize - oldSize;
+  countBytes(oldSize, newSize);
+  // only growing can start a collection, the sweep itself frees memory.
   if (newSize > oldSize)
   {
 #ifdef DEBUG_STRESS_GC
     collectGarbage();
 #endif
+
+    // a large block pays for a step of the cycle it is allocated in.
+    if (gcDue() || (newSize >= LARGE_OBJECT_SIZE && vm.gcPhase != GC_IDLE))
+    {
+      stepGarbage();
+    }
+    checkHeapLimit();
   }
 
-  if (vm.bytesAllocated > vm.nextGC)
+  // the blocks the background marker reads are not resized in place, see
+  // growValueArray() and adjustCapacity().
+  void *result = resizeBlock(pointer, oldSize, newSize);
+  if (result == NULL && newSize > 0)
   {
-    collectGarbage();
+    fprintf(stderr, "ማህደረ ትውስታ አልቋል።\n");
+    exit(1);
   }
+  return result;
+}
 
-  if (newSize == 0)
+/**
+ * mapPages - maps anonymous read/write pages in the large object space.
+ * @size: the size in bytes, it is rounded up to whole pages.
+ * Return: the mapping, or NULL if the kernel refused.
+ */
+void *mapPages(size_t size)
+{
+  void *result = allocateLarge(size);
+  if (result == NULL)
+    return NULL;
+
+  vm.largeBytes += pageRound(size);
+  checkHeapLimit();
+  return result;
+}
+
+/**
+ * unmapPages - gives back pages mapped by mapPages.
+ * @pointer: the start of the mapping, or of whole pages at its end.
+ * @size: the size that was passed to mapPages.
+ * Return: nothing.
+ */
+void unmapPages(void *pointer, size_t size)
+{
+  freeLarge(pointer, size);
+  vm.largeBytes -= pageRound(size);
+}
+
+/**
+ * objectSize - the size of the struct of an object.
+ * @object: the object.
+ * Return: the size in bytes.
+ */
+size_t objectSize(Obj *object)
+{
+  switch (object->type)
   {
-    free(pointer);
+  case OBJ_BOUND_METHOD:
+    return sizeof(ObjBoundMethod);
+  case OBJ_CLASS:
+    return sizeof(ObjClass);
+  case OBJ_CLOSURE:
+    return sizeof(ObjClosure);
+  case OBJ_FUNCTION:
+    return sizeof(ObjFunction);
+  case OBJ_INSTANCE:
+    return sizeof(ObjInstance);
+  case OBJ_LIST:
+    return sizeof(ObjList);
+  case OBJ_NATIVE:
+    return sizeof(ObjNative);
+  case OBJ_STRING:
+    return sizeof(ObjString);
+  case OBJ_UPVALUE:
+    return sizeof(ObjUpvalue);
+  case OBJ_WEAK_REF:
+    return sizeof(ObjWeakRef);
+  case OBJ_WEAK_MAP:
+    return sizeof(ObjWeakMap);
+  }
+  return 0; // Unreachable.
+}
+
+/**
+ * releaseObject - frees the memory an object owns outside of its struct.
+ * @object: the object.
+ * Return: nothing.
+ */
+static void releaseObject(Obj *object)
+{
+  switch (object->type)
+  {
+  case OBJ_CLASS:
+    freeTable(&((ObjClass *)object)->methods);
+    break;
+  case OBJ_CLOSURE:
+  {
+    ObjClosure *closure = (ObjClosure *)object;
+    FREE_ARRAY(Value, closure->upvalues, closure->upvalueCount);
+    break;
+  }
+  case OBJ_FUNCTION:
+    freeChunk(&((ObjFunction *)object)->chunk);
+    break;
+  case OBJ_INSTANCE:
+    freeTable(&((ObjInstance *)object)->fields);
+    break;
+  case OBJ_LIST:
+    freeValueArray(&((ObjList *)object)->items);
+    break;
+  case OBJ_STRING:
+  {
+    ObjString *string = (ObjString *)object;
+    if (string->kind == STRING_HEAP)
+    {
+      FREE_ARRAY(wchar_t, string->chars, string->length + 1);
+    }
+    else if (string->kind == STRING_MAPPED)
+    {
+      unmapPages(string->chars, sizeof(wchar_t) * (string->length + 1));
+    }
+    break;
+  }
+  case OBJ_WEAK_MAP:
+  {
+    ObjWeakMap *map = (ObjWeakMap *)object;
+    FREE_ARRAY(WeakEntry, map->entries, map->capacity);
+    break;
+  }
+  case OBJ_BOUND_METHOD:
+  case OBJ_NATIVE:
+  case OBJ_UPVALUE:
+  case OBJ_WEAK_REF:
+    break;
+  }
+}
+
+/**
+ * freeObject - frees an old object, the sweep puts its slot on the free
+ * list of its page.
+ * @object: the object to be freed.
+ * Return: nothing.
+ */
+static void freeObject(Obj *object)
+{
+#ifdef DEBUG_LOG_GC
+  printf("%p free type %d\n", (void *)object, object->type);
+#endif
+  if (object->isSampled)
+    freeSample(object);
+  releaseObject(object);
+  vm.bytesAllocated -= objectSize(object);
+}
+
+/**
+ * allocateOld - allocates an object in the old generation, it counts
+ * toward the next collection like everything reallocate() allocates.
+ * @size: the size of the object.
+ * @type: the type of the object.
+ * Return: the object.
+ */
+Obj *allocateOld(size_t size, ObjType type)
+{
+  vm.bytesAllocated += size;
+#ifdef DEBUG_STRESS_GC
+  collectGarbage();
+#endif
+  if (gcDue())
+    stepGarbage();
+  checkHeapLimit();
+  return allocateSlab(type, size);
+}
+
+/**
+ * nanoTime - a monotonic clock.
+ * Return: the time in nanoseconds.
+ */
+static uint64_t nanoTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * recordPause - adds the length of a pause to the pause metrics.
+ * @nanos: how long the program was stopped.
+ * Return: nothing.
+ */
+static void recordPause(uint64_t nanos)
+{
+  uint64_t micros = nanos / 1000;
+  int bucket = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+  if (bucket >= GC_PAUSE_BUCKETS)
+    bucket = GC_PAUSE_BUCKETS - 1;
+
+  vm.gcStats.pauses++;
+  vm.gcStats.pauseTotal += nanos;
+  if (nanos > vm.gcStats.pauseMax)
+    vm.gcStats.pauseMax = nanos;
+  vm.gcStats.pauseHistogram[bucket]++;
+}
+
+/**
+ * initNursery - allocates the nursery, the region young objects are bump
+ * allocated in. it is not counted in bytesAllocated, only what survives
+ * it is.
+ * Return: nothing.
+ */
+static void initNursery()
+{
+  vm.nurseryStart = (uint8_t *)malloc(NURSERY_SIZE);
+  if (vm.nurseryStart == NULL)
+    exit(1);
+  vm.nurseryTop = vm.nurseryStart;
+  vm.nurseryEnd = vm.nurseryStart + NURSERY_SIZE;
+  vm.nurseryMarks = (uint64_t *)calloc(BITMAP_WORDS(NURSERY_SIZE), sizeof(uint64_t));
+  if (vm.nurseryMarks == NULL)
+    exit(1);
+  vm.youngCollectionRequested = false;
+
+  vm.rememberedCount = 0;
+  vm.rememberedCapacity = 0;
+  vm.remembered = NULL;
+  vm.promotedCount = 0;
+  vm.promotedCapacity = 0;
+  vm.promoted = NULL;
+}
+
+/**
+ * initRegion - allocates the region, the stack the closures that do not
+ * outlive their frame are bump allocated on.
+ * Return: nothing.
+ */
+static void initRegion()
+{
+  vm.regionStart = (uint8_t *)malloc(REGION_SIZE);
+  if (vm.regionStart == NULL)
+    exit(1);
+  vm.regionTop = vm.regionStart;
+  vm.regionEnd = vm.regionStart + REGION_SIZE;
+}
+
+/**
+ * clearNurseryMarks - unmarks the young objects.
+ * Return: nothing.
+ */
+static void clearNurseryMarks()
+{
+  size_t words = (bitIndex(vm.nurseryStart, (Obj *)vm.nurseryTop) + 63) / 64;
+  memset(vm.nurseryMarks, 0, words * sizeof(uint64_t));
+}
+
+/**
+ * allocateYoung - bump allocates an object in the nursery.
+ * @size: the size of the object.
+ * Return: the memory, or NULL when the nursery is full. a young collection
+ * is then requested for the next safepoint.
+ */
+void *allocateYoung(size_t size)
+{
+  size = (size + 7) & ~(size_t)7;
+#ifdef DEBUG_STRESS_GC
+  vm.youngCollectionRequested = true;
+#endif
+  if ((size_t)(vm.nurseryEnd - vm.nurseryTop) < size)
+  {
+    vm.youngCollectionRequested = true;
     return NULL;
   }
 
-  // realloc handles the rest, if newSize is > oldSize it grows the size of the arrray otherwise it shrinks it.
-  void *result = realloc(pointer, newSize);
-  if (result == NULL)
-    exit(1);
-  return result;
+  void *result = vm.nurseryTop;
+  vm.nurseryTop += size;
+  return result;
+}
+
+/**
+ * allocateRegion - bump allocates in the region. it is given back by
+ * moving regionTop back, the collector is not involved.
+ * @size: the size.
+ * Return: the memory, or NULL when the region is full.
+ */
+void *allocateRegion(size_t size)
+{
+  size = (size + 7) & ~(size_t)7;
+  if ((size_t)(vm.regionEnd - vm.regionTop) < size)
+    return NULL;
+
+  void *result = vm.regionTop;
+  vm.regionTop += size;
+  return result;
+}
+
+/**
+ * regionSize - the bytes a closure takes in the region, its upvalues and
+ * the slot of its heap copy follow it.
+ * @object: the closure.
+ * Return: the size.
+ */
+static size_t regionSize(Obj *object)
+{
+  size_t size = sizeof(ObjClosure) + sizeof(Value) * (((ObjClosure *)object)->upvalueCount + 1);
+  return (size + 7) & ~(size_t)7;
+}
+
+/**
+ * pushObject - pushes an object on one of the GC work stacks.
+ * Return: nothing.
+ */
+static void pushObject(Obj ***stack, int *count, int *capacity, Obj *object)
+{
+  if (*capacity < *count + 1)
+  {
+    *capacity = GROW_CAPACITY(*capacity);
+    *stack = (Obj **)realloc(*stack, sizeof(Obj *) * *capacity);
+    if (*stack == NULL)
+      exit(1);
+  }
+  (*stack)[(*count)++] = object;
+}
+
+/**
+ * rememberObject - adds an old object to the remembered set, the set of
+ * old objects that may point into the nursery. young objects are ignored.
+ * @object: the object.
+ * Return: nothing.
+ */
+void rememberObject(Obj *object)
+{
+  if (isYoung(object) || object->isRemembered)
+    return;
+  object->isRemembered = true;
+  pushObject(&vm.remembered, &vm.rememberedCount, &vm.rememberedCapacity, object);
+}
+
+/**
+ * ObjForwarded - a promoted young object. the pointer to its copy takes
+ * the place of its first fields, every object is at least this big.
+ */
+typedef struct
+{
+  Obj obj;
+  Obj *copy;
+} ObjForwarded;
+
+/**
+ * copyObject - copies an object to a slot of the old generation and
+ * leaves a forwarding pointer to the copy behind.
+ * @object: the object.
+ * Return: the copy.
+ */
+static Obj *copyObject(Obj *object)
+{
+  size_t size = objectSize(object);
+  Obj *copy = allocateSlab(object->type, size);
+  memcpy(copy, object, size);
+
+  if (object->type == OBJ_UPVALUE)
+  {
+    ObjUpvalue *upvalue = (ObjUpvalue *)object;
+    if (upvalue->location == &upvalue->closed)
+      ((ObjUpvalue *)copy)->location = &((ObjUpvalue *)copy)->closed;
+  }
+
+  object->isForwarded = true;
+  ((ObjForwarded *)object)->copy = copy;
+  if (object->isSampled)
+    moveSample(object, copy);
+  return copy;
+}
+
+/**
+ * promote - copies a young object to the old generation, the first time
+ * it is reached in a young collection.
+ * @object: the object.
+ * Return: where the object lives now.
+ */
+static Obj *promote(Obj *object)
+{
+  if (object == NULL || !isYoung(object))
+    return object;
+  if (object->isForwarded)
+    return ((ObjForwarded *)object)->copy;
+
+  // a young collection runs inside a safepoint, it must not start a full one.
+  Obj *copy = copyObject(object);
+  vm.bytesAllocated += objectSize(copy);
+  promotions++;
+
+  // a copy made while marking is gray, the gray stack forgets the nursery.
+  markNewObject(copy);
+  if (vm.gcPhase == GC_MARKING)
+    markObject(copy);
+
+#ifdef DEBUG_LOG_GC
+  printf("%p promote to %p\n", (void *)object, (void *)copy);
+#endif
+
+  pushObject(&vm.promoted, &vm.promotedCount, &vm.promotedCapacity, copy);
+  return copy;
+}
+
+static void moveValue(Value *slot, MoveFn move)
+{
+  if (IS_OBJ(*slot))
+    *slot = OBJ_VAL(move(AS_OBJ(*slot)));
+}
+
+#define MOVE(slot) ((slot) = (void *)move((Obj *)(slot)))
+
+static void moveArray(ValueArray *array, MoveFn move)
+{
+  for (int i = 0; i < array->count; i++)
+  {
+    moveValue(&array->values[i], move);
+  }
+}
+
+static void moveTable(Table *table, MoveFn move)
+{
+  for (int i = 0; i <= table->capacity; i++)
+  {
+    Entry *entry = &table->entries[i];
+    if (entry->key == NULL)
+      continue;
+    MOVE(entry->key);
+    moveValue(&entry->value, move);
+  }
+}
+
+/**
+ * moveFields - updates the pointers of an object to objects that moved.
+ * @object: the object.
+ * @move: gives the new place of an object.
+ * Return: nothing.
+ */
+void moveFields(Obj *object, MoveFn move)
+{
+  switch (object->type)
+  {
+  case OBJ_BOUND_METHOD:
+  {
+    ObjBoundMethod *bound = (ObjBoundMethod *)object;
+    moveValue(&bound->receiver, move);
+    MOVE(bound->method);
+    break;
+  }
+  case OBJ_CLASS:
+  {
+    ObjClass *klass = (ObjClass *)object;
+    MOVE(klass->name);
+    moveTable(&klass->methods, move);
+    MOVE(klass->initializer);
+    break;
+  }
+  case OBJ_CLOSURE:
+  {
+    ObjClosure *closure = (ObjClosure *)object;
+    MOVE(closure->function);
+    for (int i = 0; i < closure->upvalueCount; i++)
+    {
+      moveValue(&closure->upvalues[i], move);
+    }
+    break;
+  }
+  case OBJ_FUNCTION:
+  {
+    ObjFunction *function = (ObjFunction *)object;
+    MOVE(function->name);
+    moveArray(&function->chunk.constants, move);
+    break;
+  }
+  case OBJ_INSTANCE:
+  {
+    ObjInstance *instance = (ObjInstance *)object;
+    MOVE(instance->klass);
+    moveTable(&instance->fields, move);
+    break;
+  }
+  case OBJ_LIST:
+    moveArray(&((ObjList *)object)->items, move);
+    break;
+  case OBJ_UPVALUE:
+    // open upvalues are moved through vm.openUpvalues.
+    moveValue(&((ObjUpvalue *)object)->closed, move);
+    break;
+  case OBJ_STRING:
+    MOVE(((ObjString *)object)->owner);
+    break;
+  case OBJ_NATIVE:
+    break;
+  case OBJ_WEAK_REF:
+  case OBJ_WEAK_MAP:
+    // weak, see moveWeak().
+    break;
+  }
+}
+
+static inline bool isWeak(Obj *object)
+{
+  return object->type == OBJ_WEAK_REF || object->type == OBJ_WEAK_MAP;
+}
+
+/**
+ * moveWeak - updates the weak slots of a weak ref or weak map after a
+ * collection. a ref whose target died is set to nil, a map drops the
+ * entries whose key died.
+ * @object: the object, other types are left alone.
+ * @move: gives the new place of an object, NULL for one that died.
+ * Return: nothing.
+ */
+static void moveWeak(Obj *object, MoveFn move)
+{
+  if (object->type == OBJ_WEAK_REF)
+  {
+    ObjWeakRef *ref = (ObjWeakRef *)object;
+    if (!IS_OBJ(ref->target))
+      return;
+    Obj *target = move(AS_OBJ(ref->target));
+    ref->target = target == NULL ? NIL_VAL : OBJ_VAL(target);
+  }
+  else if (object->type == OBJ_WEAK_MAP)
+  {
+    rehashWeakMap((ObjWeakMap *)object, move);
+  }
+}
+
+/**
+ * moveRoots - updates the pointers of the vm to objects that moved.
+ * @move: gives the new place of an object.
+ * Return: nothing.
+ */
+static void moveRoots(MoveFn move)
+{
+  for (Value *slot = vm.stack; slot < vm.stackTop; slot++)
+  {
+    moveValue(slot, move);
+  }
+  for (int i = 0; i < vm.frameCount; i++)
+  {
+    MOVE(vm.frames[i].closure);
+  }
+  MOVE(vm.openUpvalues);
+  for (ObjUpvalue *upvalue = vm.openUpvalues; upvalue != NULL; upvalue = upvalue->next)
+  {
+    MOVE(upvalue->next);
+  }
+  moveTable(&vm.globals, move);
+  MOVE(vm.initString);
+  // the region is not in the heap, it points into it like a root.
+  for (uint8_t *cursor = vm.regionStart; cursor < vm.regionTop; cursor += regionSize((Obj *)cursor))
+  {
+    moveFields((Obj *)cursor, move);
+    moveValue(regionCopy((ObjClosure *)cursor), move);
+  }
+}
+
+/**
+ * drainPromoted - updates the fields of the promoted objects, which may
+ * promote more, until none are left.
+ * Return: nothing.
+ */
+static void drainPromoted()
+{
+  while (vm.promotedCount > 0)
+  {
+    Obj *object = vm.promoted[--vm.promotedCount];
+    moveFields(object, promote);
+    if (isWeak(object))
+      pushObject(&youngWeak, &youngWeakCount, &youngWeakCapacity, object);
+  }
+}
+
+/**
+ * survivor - where an object lives after a young collection.
+ * @object: the object.
+ * Return: its place, or NULL for a young object that died.
+ */
+static Obj *survivor(Obj *object)
+{
+  if (!isYoung(object))
+    return object;
+  if (object->isForwarded)
+    return ((ObjForwarded *)object)->copy;
+  return NULL;
+}
+
+/**
+ * promoteEphemerons - promotes the values of the weak map entries whose
+ * key survives. a value may make another key survive, so it repeats until
+ * nothing more is promoted.
+ * Return: nothing.
+ */
+static void promoteEphemerons()
+{
+  size_t before;
+  do
+  {
+    before = promotions;
+    for (int i = 0; i < youngWeakCount; i++)
+    {
+      if (youngWeak[i]->type != OBJ_WEAK_MAP)
+        continue;
+      ObjWeakMap *map = (ObjWeakMap *)youngWeak[i];
+      for (int j = 0; j < map->capacity; j++)
+      {
+        WeakEntry *entry = &map->entries[j];
+        if (entry->key != NULL && survivor(entry->key) != NULL)
+          moveValue(&entry->value, promote);
+      }
+    }
+    drainPromoted();
+  } while (promotions != before);
+}
+
+/**
+ * collectYoung - a minor collection. everything in the nursery that is
+ * reachable from the roots or from the remembered set is copied to the old
+ * generation and the nursery is reset, so the cost follows the live young
+ * data and not the size of the heap. objects move, so it only runs at the
+ * safepoints of run(), where no C code holds object pointers.
+ * Return: nothing.
+ */
+void collectYoung()
+{
+#ifdef DEBUG_LOG_GC
+  printf("-- young gc begin\n");
+  size_t before = vm.bytesAllocated;
+#endif
+  uint64_t start = nanoTime();
+  // the background marker waits while objects move.
+  bool locked = markingConcurrently();
+  if (locked)
+    pthread_mutex_lock(&gcLock);
+
+  if (vm.gcPhase == GC_MARKING)
+  {
+    int gray = 0;
+    for (int i = 0; i < vm.grayCount; i++)
+    {
+      if (!isYoung(vm.grayStack[i]))
+        vm.grayStack[gray++] = vm.grayStack[i];
+    }
+    vm.grayCount = gray;
+  }
+
+  moveRoots(promote);
+
+  for (int i = 0; i < vm.rememberedCount; i++)
+  {
+    vm.remembered[i]->isRemembered = false;
+    moveFields(vm.remembered[i], promote);
+    if (isWeak(vm.remembered[i]))
+      pushObject(&youngWeak, &youngWeakCount, &youngWeakCapacity, vm.remembered[i]);
+  }
+  vm.rememberedCount = 0;
+
+  drainPromoted();
+  promoteEphemerons();
+  for (int i = 0; i < youngWeakCount; i++)
+  {
+    moveWeak(youngWeak[i], survivor);
+  }
+  youngWeakCount = 0;
+
+  if (vm.gcPhase == GC_MARKING)
+  {
+    // a weak object that moved is marked again, its copy is listed then.
+    int weak = 0;
+    for (int i = 0; i < weakCount; i++)
+    {
+      if (!isYoung(weakObjects[i]))
+        weakObjects[weak++] = weakObjects[i];
+    }
+    weakCount = weak;
+  }
+
+  // the strings table does not keep strings alive.
+  for (int i = 0; i <= vm.strings.capacity; i++)
+  {
+    Entry *entry = &vm.strings.entries[i];
+    if (entry->key == NULL || !isYoung((Obj *)entry->key))
+      continue;
+    if (entry->key->obj.isForwarded)
+      entry->key = (ObjString *)((ObjForwarded *)entry->key)->copy;
+    else
+      tableDelete(&vm.strings, entry->key);
+  }
+
+  for (uint8_t *cursor = vm.nurseryStart; cursor < vm.nurseryTop;)
+  {
+    Obj *object = (Obj *)cursor;
+    cursor += (objectSize(object) + 7) & ~(size_t)7;
+    if (object->isForwarded)
+      continue;
+    if (object->isSampled)
+      freeSample(object);
+    size_t before = heapSize();
+    releaseObject(object);
+    vm.gcStats.freedBytes += objectSize(object) + before - heapSize();
+  }
+#ifdef DEBUG_STRESS_GC
+  // a pointer that was not updated now points at garbage.
+  memset(vm.nurseryStart, 0xdb, vm.nurseryTop - vm.nurseryStart);
+#endif
+  clearNurseryMarks();
+  vm.nurseryTop = vm.nurseryStart;
+  vm.youngCollectionRequested = false;
+  vm.gcStats.youngCollections++;
+  if (locked)
+    pthread_mutex_unlock(&gcLock);
+  recordPause(nanoTime() - start);
+
+#ifdef DEBUG_LOG_GC
+  printf("-- young gc end\n");
+  printf("   promoted %ld bytes\n", vm.bytesAllocated - before);
+#endif
+
+  if (gcDue())
+    stepGarbage();
 }
 
 void markObject(Obj *object)
 {
   if (object == NULL)
     return;
-  if (object->isMarked)
+  // markRoots() traces the region.
+  if (isRegion(object))
+    return;
+  if (isObjectMarked(object))
     return;
 
 #ifdef DEBUG_LOG_GC
@@ -59,7 +922,20 @@ void markObject(Obj *object)
   printf("\n");
 #endif
 
-  object->isMarked = true;
+  grayObject(object);
+}
+
+/**
+ * grayObject - marks an object and pushes it on the gray stack, even if
+ * it is already marked, so that its references are traced again.
+ * @object: the object.
+ * Return: nothing.
+ */
+void grayObject(Obj *object)
+{
+  size_t index;
+  uint64_t *bitmap = markBitmap(object, &index);
+  setBit(bitmap, index);
 
   if (vm.grayCapacity < vm.grayCount + 1)
   {
@@ -74,6 +950,51 @@ void markObject(Obj *object)
   vm.grayStack[vm.grayCount++] = object;
 }
 
+/**
+ * shadeStore - the write barrier while the background marker runs.
+ * @owner: the object written to.
+ * @value: the object stored.
+ * Return: nothing.
+ */
+void shadeStore(Obj *owner, Obj *value)
+{
+  pthread_mutex_lock(&gcLock);
+  if (isObjectMarked(owner))
+    markObject(value);
+  pthread_mutex_unlock(&gcLock);
+}
+
+/**
+ * pauseMarker - takes the lock the background marker blackens under.
+ * Return: nothing.
+ */
+void pauseMarker()
+{
+  pthread_mutex_lock(&gcLock);
+}
+
+/**
+ * resumeMarker - gives back the lock pauseMarker() took.
+ * Return: nothing.
+ */
+void resumeMarker()
+{
+  pthread_mutex_unlock(&gcLock);
+}
+
+/**
+ * shadeOwner - grays an object again while the background marker runs.
+ * @owner: the object written to.
+ * Return: nothing.
+ */
+void shadeOwner(Obj *owner)
+{
+  pthread_mutex_lock(&gcLock);
+  if (isObjectMarked(owner))
+    grayObject(owner);
+  pthread_mutex_unlock(&gcLock);
+}
+
 void markValue(Value value)
 {
   if (IS_OBJ(value))
@@ -110,6 +1031,7 @@ static void blackenObject(Obj *object)
     ObjClass *klass = (ObjClass *)object;
     markObject((Obj *)klass->name);
     markTable(&klass->methods);
+    markObject((Obj *)klass->initializer);
     break;
     }
   case OBJ_CLOSURE:
@@ -118,7 +1040,7 @@ static void blackenObject(Obj *object)
     markObject((Obj *)closure->function);
     for (int i = 0; i < closure->upvalueCount; i++)
     {
-      markObject((Obj *)closure->upvalues[i]);
+      markValue(closure->upvalues[i]);
     }
     break;
   }
@@ -136,67 +1058,20 @@ static void blackenObject(Obj *object)
     markTable(&instance->fields);
     break;
   }
+  case OBJ_LIST:
+    markArray(&((ObjList *)object)->items);
+    break;
   case OBJ_UPVALUE:
     markValue(((ObjUpvalue *)object)->closed);
     break;
-  case OBJ_NATIVE:
   case OBJ_STRING:
+    markObject((Obj *)((ObjString *)object)->owner);
     break;
-  }
-}
-
-/**
- * freeObject - frees an object.
- * @object: the object to be freed.
- * Return: nothing.
- */
-static void freeObject(Obj *object)
-{
-#ifdef DEBUG_LOG_GC
-  printf("%p free type %d\n", (void *)object, object->type);
-#endif
-  switch (object->type)
-  {
-  case OBJ_BOUND_METHOD:
-      FREE(ObjBoundMethod, object);
-      break;
-  case OBJ_CLASS: {
-    ObjClass *klass = (ObjClass *)object;
-    freeTable(&klass->methods);
-    FREE(ObjClass, object);
-    break;
-    }
-  case OBJ_CLOSURE:
-    ObjClosure *closure = (ObjClosure *)object;
-    FREE_ARRAY(ObjUpvalue *, closure->upvalues, closure->upvalueCount);
-    FREE(ObjClosure, object);
-    break;
-  case OBJ_FUNCTION:
-  {
-    ObjFunction *function = (ObjFunction *)object;
-    freeChunk(&function->chunk);
-    FREE(ObjFunction, object);
-    break;
-  }
-  case OBJ_INSTANCE:
-  {
-    ObjInstance *instance = (ObjInstance *)object;
-    freeTable(&instance->fields);
-    FREE(ObjInstance, object);
-    break;
-  }
   case OBJ_NATIVE:
-    FREE(ObjNative, object);
     break;
-  case OBJ_STRING:
-  {
-    ObjString *string = (ObjString *)object;
-    FREE_ARRAY(wchar_t, string->chars, string->length + 1);
-    FREE(ObjString, object);
-    break;
-  }
-  case OBJ_UPVALUE:
-    FREE(ObjUpvalue, object);
+  case OBJ_WEAK_REF:
+  case OBJ_WEAK_MAP:
+    pushObject(&weakObjects, &weakCount, &weakCapacity, object);
     break;
   }
 }
@@ -225,8 +1100,18 @@ static void markRoots()
   markTable(&vm.globals);
   markCompilerRoots();
   markObject((Obj *)vm.initString);
+
+  for (uint8_t *cursor = vm.regionStart; cursor < vm.regionTop; cursor += regionSize((Obj *)cursor))
+  {
+    blackenObject((Obj *)cursor);
+    markValue(*regionCopy((ObjClosure *)cursor));
+  }
 }
 
+/**
+ * traceReferences - blackens gray objects until none are left.
+ * Return: nothing.
+ */
 static void traceReferences()
 {
   while (vm.grayCount > 0)
@@ -236,69 +1121,480 @@ static void traceReferences()
   }
 }
 
-static void sweep()
+/**
+ * markInBackground - the body of the marker thread. it blackens gray
+ * objects in small batches and lets the mutator take the lock between
+ * them.
+ * Return: nothing.
+ */
+static void *markInBackground(void *unused)
 {
-  Obj *previous = NULL;
-  Obj *object = vm.objects;
-  while (object != NULL)
+  pthread_mutex_lock(&gcLock);
+  for (;;)
   {
-    if (object->isMarked)
+    while (!markerQuit && (vm.gcPhase != GC_MARKING || vm.grayCount == 0))
+      pthread_cond_wait(&grayReady, &gcLock);
+    if (markerQuit)
+      break;
+
+    for (int i = 0; i < GC_STEP_OBJECTS && vm.grayCount > 0; i++)
     {
-      object->isMarked = false;
-      previous = object;
-      object = object->next;
+      blackenObject(vm.grayStack[--vm.grayCount]);
     }
-    else
+    pthread_mutex_unlock(&gcLock);
+    sched_yield();
+    pthread_mutex_lock(&gcLock);
+  }
+  pthread_mutex_unlock(&gcLock);
+  return NULL;
+}
+
+/**
+ * startMarker - starts the marker thread the first time a concurrent
+ * cycle starts.
+ * Return: nothing.
+ */
+static void startMarker()
+{
+  if (markerStarted)
+    return;
+
+  // the mutator frees blocks while it holds the lock during the sweep.
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&gcLock, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+  pthread_cond_init(&grayReady, NULL);
+
+  if (pthread_create(&marker, NULL, markInBackground, NULL) != 0)
+  {
+    // marking stays incremental.
+    vm.gcConcurrent = false;
+    return;
+  }
+  markerStarted = true;
+}
+
+/**
+ * stopMarker - stops the marker thread.
+ * Return: nothing.
+ */
+static void stopMarker()
+{
+  if (!markerStarted)
+    return;
+
+  pthread_mutex_lock(&gcLock);
+  markerQuit = true;
+  pthread_cond_signal(&grayReady);
+  pthread_mutex_unlock(&gcLock);
+  pthread_join(marker, NULL);
+  markerStarted = false;
+}
+
+/**
+ * startCycle - clears the mark bitmaps, so that every object is white,
+ * and grays the roots. marking continues in steps from here.
+ * Return: nothing.
+ */
+static void startCycle()
+{
+#ifdef DEBUG_LOG_GC
+  printf("-- gc begin\n");
+#endif
+  clearSlabMarks();
+  clearNurseryMarks();
+  vm.gcPhase = GC_MARKING;
+  vm.cycleStart = vm.bytesAllocated;
+  markRoots();
+}
+
+/**
+ * markStep - blackens gray objects until none are left or the pause
+ * budget is spent.
+ * @start: when the pause started.
+ * Return: nothing.
+ */
+static void markStep(uint64_t start)
+{
+  while (vm.grayCount > 0)
+  {
+    for (int i = 0; i < GC_STEP_OBJECTS && vm.grayCount > 0; i++)
     {
-      Obj *unreached = object;
-      object = object->next;
-      if (previous != NULL)
-      {
-        previous->next = object;
-      }
-      else
+      blackenObject(vm.grayStack[--vm.grayCount]);
+    }
+    if (nanoTime() - start >= vm.gcPauseBudget)
+      break;
+  }
+}
+
+/**
+ * markEphemerons - marks the values of the weak map entries whose key is
+ * marked. a value may mark another key, so it repeats until a pass marks
+ * nothing.
+ * Return: nothing.
+ */
+static void markEphemerons()
+{
+  bool marked;
+  do
+  {
+    marked = false;
+    for (int i = 0; i < weakCount; i++)
+    {
+      if (weakObjects[i]->type != OBJ_WEAK_MAP)
+        continue;
+      ObjWeakMap *map = (ObjWeakMap *)weakObjects[i];
+      for (int j = 0; j < map->capacity; j++)
       {
-        vm.objects = object;
+        WeakEntry *entry = &map->entries[j];
+        if (entry->key == NULL || !isObjectMarked(entry->key) ||
+            !IS_OBJ(entry->value) || isObjectMarked(AS_OBJ(entry->value)))
+          continue;
+        markObject(AS_OBJ(entry->value));
+        marked = true;
       }
-
-      freeObject(unreached);
     }
+    traceReferences();
+  } while (marked);
+}
+
+/**
+ * keepMarked - what is left of an object after a cycle.
+ * @object: the object.
+ * Return: the object, or NULL if it was not marked.
+ */
+static Obj *keepMarked(Obj *object)
+{
+  return isObjectMarked(object) ? object : NULL;
+}
+
+/**
+ * finishCycle - the last pause of a cycle. the roots are not behind the
+ * write barrier so they are marked again, then what is still gray is
+ * traced. the objects are handed to the sweep, nothing is freed here. the
+ * background marker must be waiting on the lock.
+ * Return: nothing.
+ */
+static void finishCycle()
+{
+  markRoots();
+  traceReferences();
+
+  // the weak slots are cleared before the sweep frees what they point to.
+  markEphemerons();
+  for (int i = 0; i < weakCount; i++)
+  {
+    moveWeak(weakObjects[i], keepMarked);
+  }
+  weakCount = 0;
+
+  // the remembered objects that are about to be freed.
+  int remembered = 0;
+  for (int i = 0; i < vm.rememberedCount; i++)
+  {
+    if (isObjectMarked(vm.remembered[i]))
+      vm.remembered[remembered++] = vm.remembered[i];
   }
+  vm.rememberedCount = remembered;
+
+  // young objects are traced but not swept, the next young collection
+  // frees the ones that died.
+  startSweep();
+  vm.gcPhase = GC_SWEEPING;
+
+#ifdef DEBUG_LOG_GC
+  printf("-- gc marked\n");
+#endif
 }
 
-void collectGarbage()
+/**
+ * sweepObject - frees an object that was not marked. a dead string leaves
+ * the strings table when it is freed.
+ * @object: the object.
+ * Return: nothing.
+ */
+static void sweepObject(Obj *object)
+{
+  size_t before = heapSize();
+  if (object->type == OBJ_STRING)
+    tableDelete(&vm.strings, (ObjString *)object);
+  freeObject(object);
+  vm.gcStats.freedBytes += before - heapSize();
+}
+
+/**
+ * isFragmented - whether less than half of the pages of a large enough
+ * heap holds objects.
+ * Return: true if it is.
+ */
+static bool isFragmented()
+{
+  size_t used;
+  size_t total;
+  slabUsage(&used, &total);
+  return total >= GC_COMPACT_MIN_BYTES && used * 2 < total;
+}
+
+/**
+ * nextThreshold - the size a space may grow to before the next cycle,
+ * never past the heap limit.
+ * @bytes: the size of the space after a cycle.
+ * @minimum: the smallest threshold.
+ * Return: the threshold.
+ */
+static size_t nextThreshold(size_t bytes, size_t minimum)
+{
+  size_t next = (size_t)((double)bytes * vm.gcGrowthFactor);
+  if (next < minimum)
+    next = minimum;
+  if (vm.gcMaxHeap != 0 && next > vm.gcMaxHeap)
+    next = vm.gcMaxHeap;
+  return next;
+}
+
+/**
+ * sweepStep - sweeps the pages of the heap one by one, until all are
+ * swept or the pause budget is spent.
+ * @start: when the pause started.
+ * @budget: how long the step may take.
+ * Return: nothing.
+ */
+static void sweepStep(uint64_t start, uint64_t budget)
 {
 #ifdef DEBUG_LOG_GC
-  printf("-- gc begin\n");
   size_t before = vm.bytesAllocated;
 #endif
 
-  markRoots();
-  traceReferences();
-  tableRemoveWhite(&vm.strings);
-  sweep();
+  bool more;
+  do
+  {
+    more = sweepNextPage(sweepObject);
+  } while (more && nanoTime() - start < budget);
+
+#ifdef DEBUG_LOG_GC
+  printf("   swept %ld bytes\n", before - vm.bytesAllocated);
+#endif
 
-  vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
+  if (more)
+    return;
+
+  vm.gcPhase = GC_IDLE;
+  vm.gcStats.cycles++;
+  vm.nextGC = nextThreshold(vm.bytesAllocated, vm.gcMinHeap);
+  vm.nextLargeGC = nextThreshold(vm.largeBytes, GC_LARGE_MIN_BYTES);
+  tableCompact(&vm.strings);
+  if (vm.gcCompact && isFragmented())
+    vm.compactionRequested = true;
 
 #ifdef DEBUG_LOG_GC
   printf("-- gc end\n");
-  printf("   collected %ld bytes (from %ld to %ld) next at %ld\n",
-         before - vm.bytesAllocated, before, vm.bytesAllocated, vm.nextGC);
+  printf("   %ld bytes left, next at %ld\n", vm.bytesAllocated, vm.nextGC);
+#endif
+}
+
+/**
+ * stepGarbage - does the work an allocation owes the collector. it runs a
+ * sweeping step, or starts a cycle or runs a marking step and finishes
+ * the marking once nothing is gray. with a background marker the marking
+ * step only wakes it up. a cycle the program outruns, when the heap
+ * doubled since it started, finishes its marking at once.
+ * Return: nothing.
+ */
+static void stepGarbage()
+{
+  // compacting the strings allocates, that must not start another cycle.
+  if (collecting)
+    return;
+  collecting = true;
+  uint64_t start = nanoTime();
+  if (vm.gcConcurrent)
+    startMarker();
+  // the marker waits on gcPhase under the lock.
+  bool locked = markerStarted;
+  if (locked)
+    pthread_mutex_lock(&gcLock);
+
+  if (vm.gcPhase == GC_SWEEPING)
+  {
+    sweepStep(start, vm.gcPauseBudget);
+  }
+  else
+  {
+    if (vm.gcPhase == GC_IDLE)
+      startCycle();
+    if (!vm.gcConcurrent)
+      markStep(start);
+    if (vm.grayCount == 0 ||
+        (double)vm.bytesAllocated > (double)vm.cycleStart * vm.gcGrowthFactor ||
+        (double)vm.largeBytes > (double)vm.nextLargeGC * vm.gcGrowthFactor ||
+        (vm.gcMaxHeap != 0 && heapSize() > vm.gcMaxHeap))
+      finishCycle();
+  }
+  if (locked)
+  {
+    pthread_cond_signal(&grayReady);
+    pthread_mutex_unlock(&gcLock);
+  }
+  vm.nextStep = vm.bytesAllocated + GC_STEP_BYTES;
+
+  recordPause(nanoTime() - start);
+  collecting = false;
+}
+
+/**
+ * collectGarbage - runs a whole cycle, or the rest of the current one, in
+ * one pause.
+ * Return: nothing.
+ */
+void collectGarbage()
+{
+  if (collecting)
+    return;
+  collecting = true;
+  uint64_t start = nanoTime();
+  bool locked = markerStarted;
+  if (locked)
+    pthread_mutex_lock(&gcLock);
+
+  if (vm.gcPhase == GC_SWEEPING)
+    sweepStep(start, UINT64_MAX);
+  if (vm.gcPhase == GC_IDLE)
+    startCycle();
+  finishCycle();
+  sweepStep(start, UINT64_MAX);
+
+  if (locked)
+    pthread_mutex_unlock(&gcLock);
+
+  recordPause(nanoTime() - start);
+  collecting = false;
+}
+
+static void evacuate(Obj *object)
+{
+  copyObject(object);
+}
+
+/**
+ * forward - the copy of an object that was evacuated.
+ * @object: the object, or NULL.
+ * Return: where it lives now.
+ */
+static Obj *forward(Obj *object)
+{
+  if (object == NULL || !object->isForwarded)
+    return object;
+  return ((ObjForwarded *)object)->copy;
+}
+
+static void forwardFields(Obj *object)
+{
+  moveFields(object, forward);
+  moveWeak(object, forward);
+}
+
+/**
+ * compactHeap - moves the objects of the sparse pages of the old
+ * generation into the other pages and gives the emptied pages back. the
+ * nursery is emptied first, so only old objects and the roots point at
+ * the objects that move. it runs at a safepoint between cycles, a cycle
+ * in progress holds marks and gray objects that would have to move too.
+ * Return: nothing.
+ */
+void compactHeap()
+{
+  vm.compactionRequested = false;
+  if (vm.gcPhase != GC_IDLE)
+    return;
+  collectYoung();
+  if (vm.gcPhase != GC_IDLE)
+    return;
+
+#ifdef DEBUG_LOG_GC
+  printf("-- compact begin\n");
+#endif
+  uint64_t start = nanoTime();
+  if (!startEvacuation())
+    return;
+  forEachEvacuated(evacuate);
+  vm.gcStats.compactions++;
+
+  moveRoots(forward);
+  // the strings table holds the only pointer to some strings.
+  moveTable(&vm.strings, forward);
+  forEachObject(forwardFields);
+  finishEvacuation();
+#ifdef __GLIBC__
+  // the pages were in the middle of the malloc heap, it keeps them mapped.
+  malloc_trim(0);
+#endif
+  recordPause(nanoTime() - start);
+
+#ifdef DEBUG_LOG_GC
+  size_t used;
+  size_t total;
+  slabUsage(&used, &total);
+  printf("-- compact end\n");
+  printf("   %ld bytes of objects in %ld bytes of pages\n", used, total);
 #endif
 }
 
+/**
+ * initCollector - initializes the collector and the nursery.
+ * Return: nothing.
+ */
+void initCollector()
+{
+  vm.gcPhase = GC_IDLE;
+  vm.bytesAllocated = 0;
+  vm.nextGC = GC_INITIAL_HEAP;
+  vm.gcGrowthFactor = GC_HEAP_GROW_FACTOR;
+  vm.gcMinHeap = 0;
+  vm.gcMaxHeap = 0;
+  vm.heapExhausted = false;
+  vm.largeBytes = 0;
+  vm.nextLargeGC = GC_LARGE_MIN_BYTES;
+  vm.nextStep = 0;
+  vm.cycleStart = 0;
+  vm.gcPauseBudget = GC_PAUSE_BUDGET;
+  vm.gcConcurrent = false;
+  vm.gcCompact = false;
+  vm.compactionRequested = false;
+  vm.profileCountdown = 0;
+  vm.heapDumpRequested = 0;
+  memset(&vm.gcStats, 0, sizeof(vm.gcStats));
+
+  vm.grayCount = 0;
+  vm.grayCapacity = 0;
+  vm.grayStack = NULL;
+
+  initNursery();
+  initRegion();
+}
+
 /**
  * freeObjects - frees the objects.
  * Return: nothing.
  */
 void freeObjects()
 {
-  Obj *object = vm.objects;
-  while (object != NULL)
+  stopMarker();
+  freeSlabs(freeObject);
+  for (uint8_t *cursor = vm.nurseryStart; cursor < vm.nurseryTop;)
   {
-    Obj *next = object->next;
-    freeObject(object);
-    object = next;
+    Obj *young = (Obj *)cursor;
+    cursor += (objectSize(young) + 7) & ~(size_t)7;
+    releaseObject(young);
   }
+  free(vm.nurseryStart);
+  free(vm.nurseryMarks);
+  free(vm.regionStart);
+  freeLargeCache();
   free(vm.grayStack);
+  free(vm.remembered);
+  free(vm.promoted);
+  free(weakObjects);
+  free(youngWeak);
 }
@@ -2,7 +2,14 @@
 #define AHADU_MEMORY_H
 
 #include "common.h"
+#include "large.h"
 #include "object.h"
+#include "slab.h"
+#include "vm.h"
+
+#define NURSERY_SIZE (1024 * 1024)
+#define REGION_SIZE (64 * 1024)
+#define GC_PAUSE_BUDGET (1000 * 1000)
 
 #define ALLOCATE(type, count) \
   (type*)reallocate(NULL, 0, sizeof(type) * (count))
@@ -20,10 +27,198 @@
 #define FREE(type, pointer) \
   reallocate(pointer, sizeof(type), 0)
 
+/**
+ * MoveFn - gives the place an object lives in once objects moved.
+ * @object: the object, or NULL.
+ * Return: where it lives now.
+ */
+typedef Obj *(*MoveFn)(Obj *object);
+
 void *reallocate(void *pointer, size_t oldSize, size_t newSize);
+void *mapPages(size_t size);
+void unmapPages(void *pointer, size_t size);
+size_t objectSize(Obj *object);
+void initCollector();
+void *allocateYoung(size_t size);
+void *allocateRegion(size_t size);
+Obj *allocateOld(size_t size, ObjType type);
+void rememberObject(Obj *object);
+void moveFields(Obj *object, MoveFn move);
+void collectYoung();
+void compactHeap();
+bool heapLimitReached();
 void markObject(Obj *object);
+void grayObject(Obj *object);
+void shadeStore(Obj *owner, Obj *value);
+void shadeOwner(Obj *owner);
+void pauseMarker();
+void resumeMarker();
 void markValue(Value value);
 void collectGarbage();
 void freeObjects();
 
+/**
+ * isYoung - whether an object lives in the nursery.
+ * @object: the object.
+ * Return: true if it does.
+ */
+static inline bool isYoung(Obj *object)
+{
+  return (uintptr_t)((uint8_t *)object - vm.nurseryStart) < NURSERY_SIZE;
+}
+
+/**
+ * isRegion - whether an object lives in the region of a frame. such an
+ * object is not in the heap, it is traced as a root and never marked.
+ * @object: the object.
+ * Return: true if it does.
+ */
+static inline bool isRegion(Obj *object)
+{
+  return (uintptr_t)((uint8_t *)object - vm.regionStart) < REGION_SIZE;
+}
+
+/**
+ * regionCopy - the slot after the upvalues of a region closure. it holds
+ * the heap copy of the closure once it was passed to a callee that may
+ * keep it, or nil.
+ * @closure: the region closure.
+ * Return: the slot.
+ */
+static inline Value *regionCopy(ObjClosure *closure)
+{
+  return closure->upvalues + closure->upvalueCount;
+}
+
+/**
+ * markBitmap - the bitmap that holds the mark bit of an object, the one
+ * of the nursery or the one of its slab page.
+ * @object: the object.
+ * @index: set to the index of the bit.
+ * Return: the bitmap.
+ */
+static inline uint64_t *markBitmap(Obj *object, size_t *index)
+{
+  if (isYoung(object))
+  {
+    *index = bitIndex(vm.nurseryStart, object);
+    return vm.nurseryMarks;
+  }
+  SlabPage *page = slabPage(object);
+  *index = bitIndex(page, object);
+  return page->marks;
+}
+
+/**
+ * isObjectMarked - whether an object is marked in the current cycle.
+ * @object: the object.
+ * Return: true if it is.
+ */
+static inline bool isObjectMarked(Obj *object)
+{
+  size_t index;
+  uint64_t *bitmap = markBitmap(object, &index);
+  return testBit(bitmap, index);
+}
+
+/**
+ * isObjectDead - whether an object was found dead and waits to be swept.
+ * @object: the object.
+ * Return: true if it is.
+ */
+static inline bool isObjectDead(Obj *object)
+{
+  return vm.gcPhase == GC_SWEEPING && !isObjectMarked(object);
+}
+
+/**
+ * markNewObject - a new object is marked while the sweep runs, a page the
+ * sweep has not reached yet would free it otherwise. at any other time its
+ * bit is already clear, it is white for the cycle that is marking or for
+ * the next one.
+ * @object: the object.
+ * Return: nothing.
+ */
+static inline void markNewObject(Obj *object)
+{
+  if (vm.gcPhase != GC_SWEEPING)
+    return;
+  size_t index;
+  uint64_t *bitmap = markBitmap(object, &index);
+  setBit(bitmap, index);
+}
+
+/**
+ * markingConcurrently - whether the background marker may be running.
+ * Return: true if it may.
+ */
+static inline bool markingConcurrently()
+{
+  return vm.gcPhase == GC_MARKING && vm.gcConcurrent;
+}
+
+/**
+ * lockHeap - keeps the background marker out while the mutator changes
+ * the arrays, tables and upvalues it reads. an allocation may start the
+ * marking, so it is taken after the last allocation of the change.
+ * Return: whether the marker was kept out, to pass to unlockHeap().
+ */
+static inline bool lockHeap()
+{
+  if (!markingConcurrently())
+    return false;
+  pauseMarker();
+  return true;
+}
+
+/**
+ * unlockHeap - lets the background marker in again.
+ * @locked: what lockHeap() returned.
+ * Return: nothing.
+ */
+static inline void unlockHeap(bool locked)
+{
+  if (locked)
+    resumeMarker();
+}
+
+/**
+ * writeBarrier - must be called when a value is stored into an object.
+ * it remembers an old object that now points at a young one, and while a
+ * cycle is marking it grays a value stored into a marked object, so that
+ * no black object points at a white one.
+ * @owner: the object written to.
+ * @value: the value written.
+ * Return: nothing.
+ */
+static inline void writeBarrier(Obj *owner, Value value)
+{
+  if (!IS_OBJ(value))
+    return;
+  if (isYoung(AS_OBJ(value)) && !isYoung(owner))
+    rememberObject(owner);
+  if (vm.gcPhase != GC_MARKING)
+    return;
+  if (vm.gcConcurrent)
+    shadeStore(owner, AS_OBJ(value));
+  else if (isObjectMarked(owner))
+    markObject(AS_OBJ(value));
+}
+
+/**
+ * writeBarrierAll - the write barrier for a store of many values at once.
+ * @owner: the object written to.
+ * Return: nothing.
+ */
+static inline void writeBarrierAll(Obj *owner)
+{
+  rememberObject(owner);
+  if (vm.gcPhase != GC_MARKING)
+    return;
+  if (vm.gcConcurrent)
+    shadeOwner(owner);
+  else if (isObjectMarked(owner))
+    grayObject(owner);
+}
+
 #endif // !AHADU_MEMORY_H
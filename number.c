@@ -0,0 +1,583 @@
+#define _GNU_SOURCE
+
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#include "number.h"
+#include "object.h"
+#include "vm.h"
+
+/*
+ * formatting follows Grisu2 (Florian Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers"), it always round trips
+ * and gives the shortest digits for nearly every double.
+ */
+
+typedef struct
+{
+  uint64_t f;
+  int e;
+} DiyFp;
+
+#define SIGNIFICAND_SIZE 52
+#define EXPONENT_BIAS (0x3FF + SIGNIFICAND_SIZE)
+#define HIDDEN_BIT ((uint64_t)1 << SIGNIFICAND_SIZE)
+#define SIGNIFICAND_MASK (HIDDEN_BIT - 1)
+
+// 10^k for k = -348, -340, ..., 340 as a normalized DiyFp.
+static const DiyFp cachedPowers[] = {
+    {0xfa8fd5a0081c0288, -1220}, {0xbaaee17fa23ebf76, -1193}, {0x8b16fb203055ac76, -1166},
+    {0xcf42894a5dce35ea, -1140}, {0x9a6bb0aa55653b2d, -1113}, {0xe61acf033d1a45df, -1087},
+    {0xab70fe17c79ac6ca, -1060}, {0xff77b1fcbebcdc4f, -1034}, {0xbe5691ef416bd60c, -1007},
+    {0x8dd01fad907ffc3c, -980}, {0xd3515c2831559a83, -954}, {0x9d71ac8fada6c9b5, -927},
+    {0xea9c227723ee8bcb, -901}, {0xaecc49914078536d, -874}, {0x823c12795db6ce57, -847},
+    {0xc21094364dfb5637, -821}, {0x9096ea6f3848984f, -794}, {0xd77485cb25823ac7, -768},
+    {0xa086cfcd97bf97f4, -741}, {0xef340a98172aace5, -715}, {0xb23867fb2a35b28e, -688},
+    {0x84c8d4dfd2c63f3b, -661}, {0xc5dd44271ad3cdba, -635}, {0x936b9fcebb25c996, -608},
+    {0xdbac6c247d62a584, -582}, {0xa3ab66580d5fdaf6, -555}, {0xf3e2f893dec3f126, -529},
+    {0xb5b5ada8aaff80b8, -502}, {0x87625f056c7c4a8b, -475}, {0xc9bcff6034c13053, -449},
+    {0x964e858c91ba2655, -422}, {0xdff9772470297ebd, -396}, {0xa6dfbd9fb8e5b88f, -369},
+    {0xf8a95fcf88747d94, -343}, {0xb94470938fa89bcf, -316}, {0x8a08f0f8bf0f156b, -289},
+    {0xcdb02555653131b6, -263}, {0x993fe2c6d07b7fac, -236}, {0xe45c10c42a2b3b06, -210},
+    {0xaa242499697392d3, -183}, {0xfd87b5f28300ca0e, -157}, {0xbce5086492111aeb, -130},
+    {0x8cbccc096f5088cc, -103}, {0xd1b71758e219652c, -77}, {0x9c40000000000000, -50},
+    {0xe8d4a51000000000, -24}, {0xad78ebc5ac620000, 3}, {0x813f3978f8940984, 30},
+    {0xc097ce7bc90715b3, 56}, {0x8f7e32ce7bea5c70, 83}, {0xd5d238a4abe98068, 109},
+    {0x9f4f2726179a2245, 136}, {0xed63a231d4c4fb27, 162}, {0xb0de65388cc8ada8, 189},
+    {0x83c7088e1aab65db, 216}, {0xc45d1df942711d9a, 242}, {0x924d692ca61be758, 269},
+    {0xda01ee641a708dea, 295}, {0xa26da3999aef774a, 322}, {0xf209787bb47d6b85, 348},
+    {0xb454e4a179dd1877, 375}, {0x865b86925b9bc5c2, 402}, {0xc83553c5c8965d3d, 428},
+    {0x952ab45cfa97a0b3, 455}, {0xde469fbd99a05fe3, 481}, {0xa59bc234db398c25, 508},
+    {0xf6c69a72a3989f5c, 534}, {0xb7dcbf5354e9bece, 561}, {0x88fcf317f22241e2, 588},
+    {0xcc20ce9bd35c78a5, 614}, {0x98165af37b2153df, 641}, {0xe2a0b5dc971f303a, 667},
+    {0xa8d9d1535ce3b396, 694}, {0xfb9b7cd9a4a7443c, 720}, {0xbb764c4ca7a44410, 747},
+    {0x8bab8eefb6409c1a, 774}, {0xd01fef10a657842c, 800}, {0x9b10a4e5e9913129, 827},
+    {0xe7109bfba19c0c9d, 853}, {0xac2820d9623bf429, 880}, {0x80444b5e7aa7cf85, 907},
+    {0xbf21e44003acdd2d, 933}, {0x8e679c2f5e44ff8f, 960}, {0xd433179d9c8cb841, 986},
+    {0x9e19db92b4e31ba9, 1013}, {0xeb96bf6ebadf77d9, 1039}, {0xaf87023b9bf0ee6b, 1066},
+};
+
+static const uint64_t powersOfTen[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+static DiyFp multiply(DiyFp x, DiyFp y)
+{
+  unsigned __int128 product = (unsigned __int128)x.f * y.f;
+  uint64_t high = (uint64_t)(product >> 64);
+  uint64_t low = (uint64_t)product;
+  // round the dropped half.
+  if (low & ((uint64_t)1 << 63))
+    high++;
+  return (DiyFp){high, x.e + y.e + 64};
+}
+
+static DiyFp normalize(DiyFp x)
+{
+  int shift = __builtin_clzll(x.f);
+  return (DiyFp){x.f << shift, x.e - shift};
+}
+
+/**
+ * boundaries - the halfway points to the neighbouring doubles, normalized
+ * to the exponent of the upper one.
+ */
+static void boundaries(DiyFp v, DiyFp *minus, DiyFp *plus)
+{
+  *plus = normalize((DiyFp){(v.f << 1) + 1, v.e - 1});
+  if (v.f == HIDDEN_BIT)
+    *minus = (DiyFp){(v.f << 2) - 1, v.e - 2};
+  else
+    *minus = (DiyFp){(v.f << 1) - 1, v.e - 1};
+  minus->f <<= minus->e - plus->e;
+  minus->e = plus->e;
+}
+
+/**
+ * cachedPower - picks a power of ten that brings the binary exponent
+ * e into [-60, -32].
+ * @e: the binary exponent.
+ * @k: set to the decimal exponent that has to be added back.
+ */
+static DiyFp cachedPower(int e, int *k)
+{
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int estimate = (int)dk;
+  if (dk - estimate > 0.0)
+    estimate++;
+
+  int index = (estimate >> 3) + 1;
+  *k = -(-348 + index * 8);
+  return cachedPowers[index];
+}
+
+static void roundWeed(char *buffer, int length, uint64_t delta, uint64_t rest,
+                      uint64_t tenKappa, uint64_t distance)
+{
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+  {
+    buffer[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+static int countDigits(uint32_t n)
+{
+  int digits = 1;
+  while (digits < 10 && n >= powersOfTen[digits])
+    digits++;
+  return digits;
+}
+
+/**
+ * generateDigits - writes the shortest digits inside the rounding interval.
+ * Return: the number of digits.
+ */
+static int generateDigits(DiyFp w, DiyFp upper, uint64_t delta, char *buffer, int *k)
+{
+  DiyFp one = {(uint64_t)1 << -upper.e, upper.e};
+  uint64_t distance = upper.f - w.f;
+  uint32_t integral = (uint32_t)(upper.f >> -one.e);
+  uint64_t fraction = upper.f & (one.f - 1);
+  int kappa = countDigits(integral);
+  int length = 0;
+
+  while (kappa > 0)
+  {
+    uint32_t digit = integral / (uint32_t)powersOfTen[kappa - 1];
+    integral %= (uint32_t)powersOfTen[kappa - 1];
+    if (digit != 0 || length != 0)
+      buffer[length++] = (char)('0' + digit);
+    kappa--;
+
+    uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+    if (rest <= delta)
+    {
+      *k += kappa;
+      roundWeed(buffer, length, delta, rest, powersOfTen[kappa] << -one.e, distance);
+      return length;
+    }
+  }
+
+  for (;;)
+  {
+    fraction *= 10;
+    delta *= 10;
+    char digit = (char)(fraction >> -one.e);
+    if (digit != 0 || length != 0)
+      buffer[length++] = (char)('0' + digit);
+    fraction &= one.f - 1;
+    kappa--;
+
+    if (fraction < delta)
+    {
+      *k += kappa;
+      int index = -kappa;
+      roundWeed(buffer, length, delta, fraction, one.f,
+                index < 20 ? distance * powersOfTen[index] : 0);
+      return length;
+    }
+  }
+}
+
+/**
+ * shortestDigits - the digits of a positive, finite double.
+ * @value: the number.
+ * @buffer: receives at least 17 digits.
+ * @exponent: set so that value = digits * 10^exponent.
+ * Return: the number of digits.
+ */
+static int shortestDigits(double value, char *buffer, int *exponent)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased = (int)(bits >> SIGNIFICAND_SIZE) & 0x7FF;
+  DiyFp v;
+  if (biased != 0)
+    v = (DiyFp){(bits & SIGNIFICAND_MASK) + HIDDEN_BIT, biased - EXPONENT_BIAS};
+  else
+    v = (DiyFp){bits & SIGNIFICAND_MASK, 1 - EXPONENT_BIAS};
+
+  DiyFp minus, plus;
+  boundaries(v, &minus, &plus);
+
+  int k;
+  DiyFp power = cachedPower(plus.e, &k);
+  DiyFp w = multiply(normalize(v), power);
+  DiyFp upper = multiply(plus, power);
+  DiyFp lower = multiply(minus, power);
+  lower.f++;
+  upper.f--;
+
+  *exponent = k;
+  return generateDigits(w, upper, upper.f - lower.f, buffer, exponent);
+}
+
+/**
+ * readsBack - whether digits * 10^exponent parses to value.
+ */
+static bool readsBack(const char *digits, int count, int exponent, double value)
+{
+  wchar_t text[48];
+  int length = 0;
+  for (int i = 0; i < count; i++)
+    text[length++] = digits[i];
+  text[length++] = L'e';
+  if (exponent < 0)
+  {
+    text[length++] = L'-';
+    exponent = -exponent;
+  }
+  int start = length;
+  do
+  {
+    text[length++] = L'0' + exponent % 10;
+    exponent /= 10;
+  } while (exponent > 0);
+  for (int i = start, j = length - 1; i < j; i++, j--)
+  {
+    wchar_t c = text[i];
+    text[i] = text[j];
+    text[j] = c;
+  }
+
+  double parsed;
+  return parseNumber(text, length, &parsed) && parsed == value;
+}
+
+/**
+ * shorten - Grisu2 gives one digit too many for about one double in a
+ * thousand, drops the last digit, rounding down or up, while the number
+ * still reads back the same.
+ * Return: the number of digits left.
+ */
+static int shorten(char *digits, int count, int *exponent, double value)
+{
+  while (count > 1)
+  {
+    char candidate[32];
+    int length = count - 1;
+    int candidateExponent = *exponent + 1;
+    memcpy(candidate, digits, length);
+
+    if (!readsBack(candidate, length, candidateExponent, value))
+    {
+      int i = length - 1;
+      while (i >= 0 && candidate[i] == '9')
+        candidate[i--] = '0';
+      if (i < 0)
+      {
+        candidate[0] = '1';
+        candidateExponent += length;
+        length = 1;
+      }
+      else
+      {
+        candidate[i]++;
+      }
+      if (!readsBack(candidate, length, candidateExponent, value))
+        return count;
+    }
+
+    while (length > 1 && candidate[length - 1] == '0')
+    {
+      length--;
+      candidateExponent++;
+    }
+    memcpy(digits, candidate, length);
+    count = length;
+    *exponent = candidateExponent;
+  }
+  return count;
+}
+
+static int writeExponent(char *buffer, int exponent)
+{
+  int length = 0;
+  buffer[length++] = 'e';
+  buffer[length++] = exponent < 0 ? '-' : '+';
+  if (exponent < 0)
+    exponent = -exponent;
+  if (exponent >= 100)
+    buffer[length++] = (char)('0' + exponent / 100);
+  if (exponent >= 10)
+    buffer[length++] = (char)('0' + exponent / 10 % 10);
+  buffer[length++] = (char)('0' + exponent % 10);
+  return length;
+}
+
+/**
+ * formatNumber - writes the shortest text that reads back as the same
+ * number. integers up to 1e21 and fractions down to 1e-7 are written out,
+ * anything else uses an exponent: 1e+21, 1.5e-7.
+ * @value: the number.
+ * @buffer: at least NUMBER_BUFFER_SIZE bytes.
+ * Return: the length of the text, the buffer is also null terminated.
+ */
+int formatNumber(double value, char *buffer)
+{
+  int length = 0;
+  if (isnan(value))
+  {
+    memcpy(buffer, "nan", 4);
+    return 3;
+  }
+  if (signbit(value))
+  {
+    buffer[length++] = '-';
+    value = -value;
+  }
+  if (isinf(value))
+  {
+    memcpy(buffer + length, "inf", 4);
+    return length + 3;
+  }
+  if (value == 0)
+  {
+    buffer[length++] = '0';
+    buffer[length] = '\0';
+    return length;
+  }
+
+  char digits[32];
+  int exponent;
+  int count = shortestDigits(value, digits, &exponent);
+  count = shorten(digits, count, &exponent, value);
+  // the position of the decimal point relative to the first digit.
+  int point = count + exponent;
+  char *out = buffer + length;
+
+  if (count <= point && point <= 21)
+  {
+    // 1234e2 -> 123400
+    memcpy(out, digits, count);
+    memset(out + count, '0', point - count);
+    length += point;
+  }
+  else if (0 < point && point <= 21)
+  {
+    // 1234e-2 -> 12.34
+    memcpy(out, digits, point);
+    out[point] = '.';
+    memcpy(out + point + 1, digits + point, count - point);
+    length += count + 1;
+  }
+  else if (-6 < point && point <= 0)
+  {
+    // 1234e-6 -> 0.001234
+    out[0] = '0';
+    out[1] = '.';
+    memset(out + 2, '0', -point);
+    memcpy(out + 2 - point, digits, count);
+    length += 2 - point + count;
+  }
+  else
+  {
+    // 1234e30 -> 1.234e+33
+    int written = 0;
+    out[written++] = digits[0];
+    if (count > 1)
+    {
+      out[written++] = '.';
+      memcpy(out + written, digits + 1, count - 1);
+      written += count - 1;
+    }
+    written += writeExponent(out + written, point - 1);
+    length += written;
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+// the powers of ten a double holds exactly.
+static const double exactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static bool isDigit(wchar_t c)
+{
+  return c >= L'0' && c <= L'9';
+}
+
+/**
+ * slowParse - reads the number with strtod in the C locale, for the inputs
+ * that the fast path can not round correctly.
+ */
+static bool slowParse(const wchar_t *chars, int length, double *value)
+{
+  static locale_t cLocale = (locale_t)0;
+  if (cLocale == (locale_t)0)
+    cLocale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+
+  char small[64];
+  char *text = length < (int)sizeof(small) ? small : malloc(length + 1);
+  if (text == NULL)
+    return false;
+  // the text was validated, it only has ascii characters.
+  for (int i = 0; i < length; i++)
+    text[i] = (char)chars[i];
+  text[length] = '\0';
+
+  *value = strtod_l(text, NULL, cLocale);
+  if (text != small)
+    free(text);
+  return true;
+}
+
+/**
+ * parseNumber - reads a decimal number like 12, -3.5 or 6.02e23. numbers
+ * with up to 19 digits and a small exponent are converted exactly with one
+ * multiplication or division, the rest go through strtod_l.
+ * @chars: the text.
+ * @length: the number of characters.
+ * @value: receives the number.
+ * Return: false if the text is not a number.
+ */
+bool parseNumber(const wchar_t *chars, int length, double *value)
+{
+  int i = 0;
+  bool negative = false;
+  if (i < length && (chars[i] == L'-' || chars[i] == L'+'))
+  {
+    negative = chars[i] == L'-';
+    i++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;        // significant digits in the mantissa.
+  int dropped = 0;       // integer digits that did not fit.
+  int exponent = 0;
+  bool any = false;
+  bool truncated = false;
+
+  for (; i < length && isDigit(chars[i]); i++)
+  {
+    any = true;
+    if (digits < 19)
+    {
+      mantissa = mantissa * 10 + (chars[i] - L'0');
+      if (mantissa != 0)
+        digits++;
+    }
+    else
+    {
+      dropped++;
+      truncated |= chars[i] != L'0';
+    }
+  }
+  if (i < length && chars[i] == L'.')
+  {
+    i++;
+    for (; i < length && isDigit(chars[i]); i++)
+    {
+      any = true;
+      if (digits < 19)
+      {
+        mantissa = mantissa * 10 + (chars[i] - L'0');
+        if (mantissa != 0)
+          digits++;
+        exponent--;
+      }
+      else
+      {
+        truncated |= chars[i] != L'0';
+      }
+    }
+  }
+  if (!any)
+    return false;
+
+  if (i < length && (chars[i] == L'e' || chars[i] == L'E'))
+  {
+    i++;
+    bool negativeExponent = false;
+    if (i < length && (chars[i] == L'-' || chars[i] == L'+'))
+    {
+      negativeExponent = chars[i] == L'-';
+      i++;
+    }
+    if (i == length || !isDigit(chars[i]))
+      return false;
+
+    int written = 0;
+    for (; i < length && isDigit(chars[i]); i++)
+    {
+      if (written < 100000)
+        written = written * 10 + (chars[i] - L'0');
+    }
+    exponent += negativeExponent ? -written : written;
+  }
+  if (i != length)
+    return false;
+
+  exponent += dropped;
+  if (mantissa == 0)
+  {
+    *value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  // Clinger's fast path: both the mantissa and the power are exact doubles.
+  if (!truncated && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+  {
+    double result = (double)mantissa;
+    result = exponent < 0 ? result / exactPowers[-exponent] : result * exactPowers[exponent];
+    *value = negative ? -result : result;
+    return true;
+  }
+
+  return slowParse(chars, length, value);
+}
+
+/**
+ * numberNative - reads a number from a string, gives ባዶ if the string is
+ * not a number. spaces around the number are ignored.
+ */
+static bool numberNative(int argCount, Value *args)
+{
+  if (IS_NUMBER(args[0]))
+  {
+    args[-1] = args[0];
+    return true;
+  }
+  if (!IS_STRING(args[0]))
+  {
+    runtimeError(L"ቁጥር ሀረግ ያስፈልገዋል።");
+    return false;
+  }
+
+  ObjString *string = AS_STRING(args[0]);
+  const wchar_t *chars = string->chars;
+  int length = string->length;
+  while (length > 0 && iswspace(chars[0]))
+  {
+    chars++;
+    length--;
+  }
+  while (length > 0 && iswspace(chars[length - 1]))
+    length--;
+
+  double value;
+  args[-1] = parseNumber(chars, length, &value) ? NUMBER_VAL(value) : NIL_VAL;
+  return true;
+}
+
+/**
+ * initNumberNatives - defines the number natives.
+ * Return: nothing.
+ */
+void initNumberNatives()
+{
+  defineNative(L"ቁጥር", 1, numberNative);
+}
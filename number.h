@@ -0,0 +1,15 @@
+#ifndef AHADU_NUMBER_H
+#define AHADU_NUMBER_H
+
+#include <wchar.h>
+
+#include "common.h"
+
+// enough for "-2.2250738585072014e-308" and the terminator.
+#define NUMBER_BUFFER_SIZE 32
+
+int formatNumber(double value, char *buffer);
+bool parseNumber(const wchar_t *chars, int length, double *value);
+void initNumberNatives();
+
+#endif // !AHADU_NUMBER_H
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 
 #include "memory.h"
 #include "object.h"
+#include "profile.h"
 #include "table.h"
 #include "value.h"
 #include "vm.h"
@@ -11,19 +13,33 @@
 #define ALLOCATE_OBJ(type, objectType) \
   (type *)allocateObject(sizeof(type), objectType)
 
+/**
+ * allocateObject - allocates an object in the nursery, or in a slab page
+ * of the old generation when the nursery is full. an old object is
+ * remembered since it is about to be pointed at young objects.
+ * @size: the size of the object.
+ * @type: the type of the object.
+ * Return: the object.
+ */
 static Obj *allocateObject(size_t size, ObjType type)
 {
-  Obj *object = (Obj *)reallocate(NULL, 0, size);
+  Obj *object = (Obj *)allocateYoung(size);
+  bool young = object != NULL;
+  if (!young)
+    object = allocateOld(size, type);
   object->type = type;
-  object->isMarked = false;
-
-  object->next = vm.objects;
+  object->isRemembered = false;
+  object->isForwarded = false;
+  object->isSampled = false;
+  markNewObject(object);
+  profileAllocation(object, size);
 
   #ifdef DEBUG_LOG_GC
     printf("%p allocate %zu for %d\n", (void *)object, size, type);
   #endif
 
-  vm.objects = object;
+  if (!young)
+    rememberObject(object);
   return object;
 }
 
@@ -39,15 +55,17 @@ ObjClass *newClass(ObjString *name)
   ObjClass *klass = ALLOCATE_OBJ(ObjClass, OBJ_CLASS);
   klass->name = name;
   initTable(&klass->methods);
+  klass->initializer = NULL;
+  klass->fieldCount = 0;
   return klass;
 }
 
 ObjClosure *newClosure(ObjFunction *function)
 {
-  ObjUpvalue **upvalues = ALLOCATE(ObjUpvalue *, function->upvalueCount);
+  Value *upvalues = ALLOCATE(Value, function->upvalueCount);
   for (int i = 0; i < function->upvalueCount; i++)
   {
-    upvalues[i] = NULL;
+    upvalues[i] = NIL_VAL;
   }
   ObjClosure *closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
   closure->function = function;
@@ -56,11 +74,40 @@ ObjClosure *newClosure(ObjFunction *function)
   return closure;
 }
 
+/**
+ * newRegionClosure - makes a closure in the region, for one the compiler
+ * proved does not outlive its frame. its upvalues follow it, it is freed
+ * with the region and the collector only traces it.
+ * @function: the function.
+ * Return: the closure, or NULL when the region is full.
+ */
+ObjClosure *newRegionClosure(ObjFunction *function)
+{
+  int count = function->upvalueCount;
+  ObjClosure *closure = (ObjClosure *)allocateRegion(sizeof(ObjClosure) + sizeof(Value) * (count + 1));
+  if (closure == NULL)
+    return NULL;
+  closure->obj.type = OBJ_CLOSURE;
+  closure->obj.isRemembered = false;
+  closure->obj.isForwarded = false;
+  closure->obj.isSampled = false;
+  closure->function = function;
+  closure->upvalues = (Value *)(closure + 1);
+  for (int i = 0; i < count; i++)
+  {
+    closure->upvalues[i] = NIL_VAL;
+  }
+  closure->upvalueCount = count;
+  *regionCopy(closure) = NIL_VAL;
+  return closure;
+}
+
 ObjFunction *newFunction()
 {
   ObjFunction *function = ALLOCATE_OBJ(ObjFunction, OBJ_FUNCTION);
   function->arity = 0;
   function->upvalueCount = 0;
+  function->calledParams = 0;
   function->name = NULL;
   initChunk(&function->chunk);
   return function;
@@ -71,22 +118,40 @@ ObjInstance *newInstance(ObjClass *klass)
   ObjInstance *instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
   instance->klass = klass;
   initTable(&instance->fields);
+  if (klass->fieldCount > 0)
+  {
+    // the fields are set by the initializer without growing the table.
+    push(OBJ_VAL(instance));
+    tableReserve(&instance->fields, klass->fieldCount);
+    pop();
+  }
   return instance;
 }
 
-ObjNative *newNative(NativeFn function)
+ObjList *newList()
+{
+  ObjList *list = ALLOCATE_OBJ(ObjList, OBJ_LIST);
+  initValueArray(&list->items);
+  return list;
+}
+
+ObjNative *newNative(NativeFn function, int arity)
 {
   ObjNative *native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
+  native->arity = arity;
   native->function = function;
   return native;
 }
 
-static ObjString *allocateString(wchar_t *chars, int length, uint32_t hash)
+static ObjString *allocateString(wchar_t *chars, int length, uint32_t hash,
+                                 StringKind kind, ObjString *owner)
 {
   ObjString *string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
+  string->kind = kind;
   string->length = length;
   string->chars = chars;
   string->hash = hash;
+  string->owner = owner;
 
   push(OBJ_VAL(string));
   tableSet(&vm.strings, string, NIL_VAL);
@@ -115,7 +180,25 @@ ObjString *takeString(wchar_t *chars, int length)
     FREE_ARRAY(wchar_t, chars, length + 1);
     return interned;
   }
-  return allocateString(chars, length, hash);
+  return allocateString(chars, length, hash, STRING_HEAP, NULL);
+}
+
+/**
+ * takeMappedString - takes ownership of characters in a mapPages region.
+ * @chars: the null terminated characters, mapped with mapPages.
+ * @length: the number of characters.
+ * Return: the string, the region is unmapped if an equal string exists.
+ */
+ObjString *takeMappedString(wchar_t *chars, int length)
+{
+  uint32_t hash = hashString(chars, length);
+  ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
+  if (interned != NULL)
+  {
+    unmapPages(chars, sizeof(wchar_t) * (length + 1));
+    return interned;
+  }
+  return allocateString(chars, length, hash, STRING_MAPPED, NULL);
 }
 
 ObjString *copyString(const wchar_t *chars, int length)
@@ -127,7 +210,30 @@ ObjString *copyString(const wchar_t *chars, int length)
   wchar_t *heapChars = ALLOCATE(wchar_t, length + 1);
   wmemcpy(heapChars, chars, length);
   heapChars[length] = L'\0';
-  return allocateString(heapChars, length, hash);
+  return allocateString(heapChars, length, hash, STRING_HEAP, NULL);
+}
+
+/**
+ * sliceString - makes a string out of a range of another string without
+ * copying, the slice keeps the buffer it points into alive.
+ * @string: the string to slice.
+ * @start: the index of the first character, must be in range.
+ * @length: the number of characters, must be in range.
+ * Return: the slice, or an already interned equal string.
+ */
+ObjString *sliceString(ObjString *string, int start, int length)
+{
+  if (start == 0 && length == string->length)
+    return string;
+
+  const wchar_t *chars = string->chars + start;
+  uint32_t hash = hashString(chars, length);
+  ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
+  if (interned != NULL)
+    return interned;
+
+  ObjString *owner = string->kind == STRING_SLICE ? string->owner : string;
+  return allocateString((wchar_t *)chars, length, hash, STRING_SLICE, owner);
 }
 
 ObjUpvalue *newUpvalue(Value *slot)
@@ -139,43 +245,123 @@ ObjUpvalue *newUpvalue(Value *slot)
   return upvalue;
 }
 
-static void printFunction(ObjFunction *function)
+ObjWeakRef *newWeakRef(Value target)
+{
+  ObjWeakRef *ref = ALLOCATE_OBJ(ObjWeakRef, OBJ_WEAK_REF);
+  ref->target = target;
+  return ref;
+}
+
+ObjWeakMap *newWeakMap()
+{
+  ObjWeakMap *map = ALLOCATE_OBJ(ObjWeakMap, OBJ_WEAK_MAP);
+  map->count = 0;
+  map->capacity = 0;
+  map->entries = NULL;
+  return map;
+}
+
+/**
+ * appendString - appends a string, slices are not null terminated so the
+ * characters are copied up to the length of the string.
+ * @text: the text buffer.
+ * @string: the string to append.
+ * Return: nothing.
+ */
+static void appendString(TextBuffer *text, ObjString *string)
+{
+  appendChars(text, string->chars, string->length);
+}
+
+static void appendFunction(TextBuffer *text, ObjFunction *function)
 {
   if (function->name == NULL)
   {
-    printf("<script>");
+    appendAscii(text, "<script>");
     return;
   }
-  printf("<fn %ls>", function->name->chars);
+  appendAscii(text, "<fn ");
+  appendString(text, function->name);
+  appendAscii(text, ">");
+}
+
+// the lists appendObject() is printing the items of, the outermost first.
+// a list that contains itself, or nesting deeper than this, prints as [...].
+#define PRINT_DEPTH_MAX 64
+static ObjList *printing[PRINT_DEPTH_MAX];
+static int printingCount = 0;
+
+/**
+ * isPrinting - whether the items of a list are already being printed.
+ * @list: the list.
+ * Return: true if they are, or if the nesting is too deep.
+ */
+static bool isPrinting(ObjList *list)
+{
+  if (printingCount == PRINT_DEPTH_MAX)
+    return true;
+  for (int i = 0; i < printingCount; i++)
+  {
+    if (printing[i] == list)
+      return true;
+  }
+  return false;
 }
 
-void printObject(Value value)
+void appendObject(TextBuffer *text, Value value)
 {
   switch (OBJ_TYPE(value))
   {
   case OBJ_CLASS:
-    printf("%ls", AS_CLASS(value)->name->chars);
+    appendString(text, AS_CLASS(value)->name);
     break;
   case OBJ_BOUND_METHOD:
-    printFunction(AS_BOUND_METHOD(value)->method->function);
+    appendFunction(text, AS_BOUND_METHOD(value)->method->function);
     break;
   case OBJ_CLOSURE:
-    printFunction(AS_CLOSURE(value)->function);
+    appendFunction(text, AS_CLOSURE(value)->function);
     break;
   case OBJ_FUNCTION:
-    printFunction(AS_FUNCTION(value));
+    appendFunction(text, AS_FUNCTION(value));
     break;
   case OBJ_INSTANCE:
-    printf("%ls instance", AS_INSTANCE(value)->klass->name->chars);
+    appendString(text, AS_INSTANCE(value)->klass->name);
+    appendAscii(text, " instance");
+    break;
+  case OBJ_LIST:
+  {
+    ObjList *list = AS_LIST(value);
+    if (isPrinting(list))
+    {
+      appendAscii(text, "[...]");
+      break;
+    }
+    printing[printingCount++] = list;
+    appendAscii(text, "[");
+    for (int i = 0; i < list->items.count; i++)
+    {
+      if (i > 0)
+        appendAscii(text, ", ");
+      appendValue(text, list->items.values[i]);
+    }
+    appendAscii(text, "]");
+    printingCount--;
     break;
+  }
   case OBJ_NATIVE:
-    printf("<native fn>");
+    appendAscii(text, "<native fn>");
     break;
   case OBJ_STRING:
-    printf("%ls", AS_STRING(value)->chars);
+    appendString(text, AS_STRING(value));
     break;
   case OBJ_UPVALUE:
-    printf("upvalue");
+    appendAscii(text, "upvalue");
+    break;
+  case OBJ_WEAK_REF:
+    appendAscii(text, "<weak ref>");
+    break;
+  case OBJ_WEAK_MAP:
+    appendAscii(text, "<weak map>");
     break;
   }
 }
@@ -11,57 +11,121 @@
 #define IS_BOUND_METHOD(value) isObjType(value, OBJ_BOUND_METHOD)
 #define IS_CLASS(value) isObjType(value, OBJ_CLASS)
 #define IS_CLOSURE(value) isObjType(value, OBJ_CLOSURE)
+#define IS_UPVALUE(value) isObjType(value, OBJ_UPVALUE)
 #define IS_FUNCTION(value) isObjType(value, OBJ_FUNCTION)
 #define IS_INSTANCE(value) isObjType(value, OBJ_INSTANCE)
+#define IS_LIST(value) isObjType(value, OBJ_LIST)
 #define IS_NATIVE(value) isObjType(value, OBJ_NATIVE)
 #define IS_STRING(value) isObjType(value, OBJ_STRING)
+#define IS_WEAK_REF(value) isObjType(value, OBJ_WEAK_REF)
+#define IS_WEAK_MAP(value) isObjType(value, OBJ_WEAK_MAP)
 
 #define AS_BOUND_METHOD(value) ((ObjBoundMethod *)AS_OBJ(value))
 #define AS_CLASS(value) ((ObjClass *)AS_OBJ(value))
 #define AS_CLOSURE(value) ((ObjClosure *)AS_OBJ(value))
+#define AS_UPVALUE(value) ((ObjUpvalue *)AS_OBJ(value))
 #define AS_FUNCTION(value) ((ObjFunction *)AS_OBJ(value))
 #define AS_INSTANCE(value) ((ObjInstance *)AS_OBJ(value))
+#define AS_LIST(value) ((ObjList *)AS_OBJ(value))
 #define AS_NATIVE(value) (((ObjNative *)AS_OBJ(value))->function)
 #define AS_STRING(value) ((ObjString *)AS_OBJ(value))
 #define AS_CSTRING(value) (((ObjString *)AS_OBJ(value))->chars)
+#define AS_WEAK_REF(value) ((ObjWeakRef *)AS_OBJ(value))
+#define AS_WEAK_MAP(value) ((ObjWeakMap *)AS_OBJ(value))
 
 typedef enum {
   OBJ_BOUND_METHOD,
   OBJ_CLASS,
   OBJ_INSTANCE,
+  OBJ_LIST,
   OBJ_CLOSURE,
   OBJ_FUNCTION,
   OBJ_NATIVE,
   OBJ_STRING,
   OBJ_UPVALUE,
+  OBJ_WEAK_REF,
+  OBJ_WEAK_MAP,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_WEAK_MAP + 1)
+
+/**
+ * Obj - the header every object starts with. it takes four bytes, the
+ * first fields of an object share its word. the mark bits live in
+ * bitmaps beside the objects and the objects of a page are found through
+ * the page, so there is no list through the objects.
+ * @type: the ObjType of the object.
+ * @isRemembered: whether it is in the remembered set.
+ * @isForwarded: whether a young object was promoted, the word after the
+ * header then points to the copy.
+ * @isSampled: whether the allocation profiler follows the object.
+ */
 struct Obj {
-  ObjType type;
-  bool isMarked;
-  struct Obj *next;
+  uint8_t type;
+  bool isRemembered;
+  bool isForwarded;
+  bool isSampled;
 };
 
+// the parameters past it are never taken to be only called.
+#define CALLED_PARAMS_MAX 32
+
+/**
+ * ObjFunction - a compiled function.
+ * @arity: the number of parameters.
+ * @upvalueCount: the number of variables it captures.
+ * @calledParams: a bit for each of the first CALLED_PARAMS_MAX parameters
+ *                the function does nothing with but call, a region closure
+ *                passed to one stays in the region.
+ * @chunk: the bytecode.
+ * @name: the name, NULL for the script.
+ */
 typedef struct {
   Obj obj;
   int arity;
   int upvalueCount;
+  uint32_t calledParams;
   Chunk chunk;
   ObjString *name;
 } ObjFunction;
 
-typedef Value (*NativeFn)(int argCount, Value *args);
+/**
+ * NativeFn - a function implemented in C.
+ * @argCount: the number of arguments.
+ * @args: the arguments, args[-1] is the callee slot the result is written to.
+ * Return: false after reporting a runtimeError(), true otherwise.
+ */
+typedef bool (*NativeFn)(int argCount, Value *args);
 
 typedef struct {
   Obj obj;
+  int arity; // -1 accepts any number of arguments.
   NativeFn function;
 } ObjNative;
 
+/**
+ * StringKind - where the characters of a string live.
+ * STRING_HEAP: chars is a heap array owned by the string.
+ * STRING_MAPPED: chars is a read-only mmap region owned by the string.
+ * STRING_SLICE: chars points into the buffer of owner, nothing is owned.
+ */
+typedef enum {
+  STRING_HEAP,
+  STRING_MAPPED,
+  STRING_SLICE,
+} StringKind;
+
+/**
+ * @chars: the characters, only heap and mapped strings are null terminated.
+ * @owner: the string whose buffer a slice points into, kept alive by the GC.
+ */
 struct ObjString {
   Obj obj;
+  StringKind kind;
   int length;
   wchar_t *chars;
   uint32_t hash;
+  struct ObjString *owner;
 };
 
 typedef struct ObjUpvalue {
@@ -71,17 +135,32 @@ typedef struct ObjUpvalue {
   struct ObjUpvalue *next;
 } ObjUpvalue;
 
+/**
+ * ObjClosure - a function with the variables it captured. a variable that
+ * is never assigned is copied in by value, one that is assigned is shared
+ * through an ObjUpvalue, the value of the slot tells which.
+ */
 typedef struct {
   Obj obj;
   ObjFunction *function;
-  ObjUpvalue **upvalues;
+  Value *upvalues;
   int upvalueCount;
 } ObjClosure;
 
+/**
+ * ObjClass - a class.
+ * @name: the name of the class.
+ * @methods: the methods, with the ones it inherited.
+ * @initializer: the ማስጀመሪያ method, or NULL when it has none.
+ * @fieldCount: the fields the last instance had when its initializer
+ *              returned, new instances are made with room for them.
+ */
 typedef struct {
   Obj obj;
   ObjString *name;
   Table methods;
+  ObjClosure *initializer;
+  int fieldCount;
 } ObjClass;
 
 typedef struct {
@@ -96,16 +175,57 @@ typedef struct {
   ObjClosure *method;
 } ObjBoundMethod;
 
+typedef struct {
+  Obj obj;
+  ValueArray items;
+} ObjList;
+
+/**
+ * ObjWeakRef - a reference that does not keep its target alive, the
+ * collector sets the target to nil once it is freed.
+ */
+typedef struct {
+  Obj obj;
+  Value target;
+} ObjWeakRef;
+
+typedef struct {
+  Obj *key;
+  Value value;
+} WeakEntry;
+
+/**
+ * ObjWeakMap - a map from objects to values that does not keep its keys
+ * alive, a value is only kept alive as long as its key is. the collector
+ * removes an entry once its key is freed. keys are compared by identity
+ * and hashed by address, so the collector rehashes a map whose keys move.
+ * @count: the number of entries.
+ * @capacity: the number of slots, a power of two or 0.
+ * @entries: the slots, an empty slot has a NULL key.
+ */
+typedef struct {
+  Obj obj;
+  int count;
+  int capacity;
+  WeakEntry *entries;
+} ObjWeakMap;
+
 ObjBoundMethod *newBoundMethod(Value receiver, ObjClosure *method);
 ObjClass *newClass(ObjString *name);
 ObjClosure *newClosure(ObjFunction *function);
+ObjClosure *newRegionClosure(ObjFunction *function);
 ObjFunction *newFunction();
 ObjInstance *newInstance(ObjClass *klass);
-ObjNative *newNative(NativeFn function);
+ObjList *newList();
+ObjNative *newNative(NativeFn function, int arity);
 ObjString *takeString(wchar_t *chars, int length);
+ObjString *takeMappedString(wchar_t *chars, int length);
 ObjString *copyString(const wchar_t *chars, int length);
+ObjString *sliceString(ObjString *string, int start, int length);
 ObjUpvalue *newUpvalue(Value *slot);
-void printObject(Value value);
+ObjWeakRef *newWeakRef(Value target);
+ObjWeakMap *newWeakMap();
+void appendObject(TextBuffer *text, Value value);
 
 static inline bool isObjType(Value value, ObjType type) {
   return IS_OBJ(value) && AS_OBJ(value)->type == type;
@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "memory.h"
+#include "profile.h"
+#include "vm.h"
+
+// the longest stack a site keeps, in bytes of folded frames.
+#define PROFILE_STACK_MAX 4096
+
+/**
+ * Site - a stack that allocated sampled objects.
+ * @stack: the frames from the outermost one, "name:line" separated by
+ *         ';'. it is UTF-8 and null terminated.
+ * @hash: the hash of the stack.
+ * @bytes: the bytes the samples stand for.
+ * @objects: the objects the samples stand for.
+ * @liveBytes: the part of bytes that is not freed yet.
+ * @liveObjects: the part of objects that is not freed yet.
+ */
+typedef struct
+{
+  char *stack;
+  uint32_t hash;
+  double bytes;
+  double objects;
+  double liveBytes;
+  double liveObjects;
+} Site;
+
+/**
+ * Sample - a sampled object that is alive.
+ * @object: the object, NULL in an empty slot and TOMBSTONE in a freed one.
+ * @site: the index of the site that allocated it.
+ * @bytes: the bytes the sample stands for.
+ * @objects: the objects the sample stands for.
+ */
+typedef struct
+{
+  Obj *object;
+  int site;
+  double bytes;
+  double objects;
+} Sample;
+
+#define TOMBSTONE ((Obj *)1)
+
+static size_t sampleBytes = 0;
+
+static Site *sites = NULL;
+static int siteCount = 0;
+static int siteCapacity = 0;
+// the indexes of the sites by hash, -1 in an empty slot.
+static int *siteIndex = NULL;
+static int siteIndexCapacity = 0;
+
+static Sample *samples = NULL;
+static int sampleCount = 0;
+static int sampleUsed = 0; // the slots that are in use or freed.
+static int sampleCapacity = 0;
+
+/**
+ * growOrExit - resizes a block of the profiler, outside of the heap of
+ * the collector.
+ * @pointer: the block, or NULL.
+ * @size: the new size.
+ * Return: the block.
+ */
+static void *growOrExit(void *pointer, size_t size)
+{
+  void *result = realloc(pointer, size);
+  if (result == NULL)
+    exit(1);
+  return result;
+}
+
+static uint32_t hashBytes(const char *bytes, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= (uint8_t)bytes[i];
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+static uint32_t hashPointer(Obj *object)
+{
+  uint64_t key = (uint64_t)(uintptr_t)object;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return (uint32_t)key;
+}
+
+/**
+ * startProfile - starts the allocation profiler.
+ * @bytes: the bytes allocated between two samples, 1 samples every
+ *         object.
+ * Return: nothing.
+ */
+void startProfile(size_t bytes)
+{
+  sampleBytes = bytes == 0 ? 1 : bytes;
+  vm.profileCountdown = sampleBytes;
+}
+
+/**
+ * appendFrame - appends a frame to a folded stack.
+ * @stack: the stack.
+ * @length: the length of the stack, moved past the frame.
+ * @frame: the frame.
+ * Return: nothing.
+ */
+static void appendFrame(char *stack, size_t *length, CallFrame *frame)
+{
+  ObjFunction *function = frame->closure->function;
+  // the ip is past the instruction that runs, unless none ran yet.
+  size_t instruction = frame->ip > function->chunk.code
+                           ? (size_t)(frame->ip - function->chunk.code - 1)
+                           : 0;
+  int line = function->chunk.lines[instruction];
+  // the name, the separators and the line have to fit.
+  size_t nameLength = function->name == NULL ? 8 : (size_t)function->name->length;
+  if (*length + 4 * nameLength + 16 > PROFILE_STACK_MAX)
+    return;
+
+  if (*length > 0)
+    stack[(*length)++] = ';';
+  if (function->name == NULL)
+  {
+    memcpy(stack + *length, "<script>", 8);
+    *length += 8;
+  }
+  else
+  {
+    *length += encodeUtf8(function->name->chars, function->name->length,
+                          stack + *length);
+  }
+  *length += (size_t)snprintf(stack + *length, 16, ":%d", line);
+}
+
+/**
+ * findSite - finds the site of a stack, or adds it.
+ * @stack: the folded stack.
+ * @length: the length of the stack.
+ * Return: the index of the site.
+ */
+static int findSite(const char *stack, size_t length)
+{
+  if (siteCount + 1 > siteIndexCapacity / 2)
+  {
+    int capacity = GROW_CAPACITY(siteIndexCapacity);
+    int *index = (int *)growOrExit(NULL, sizeof(int) * capacity);
+    for (int i = 0; i < capacity; i++)
+      index[i] = -1;
+    for (int i = 0; i < siteCount; i++)
+    {
+      uint32_t slot = sites[i].hash & (capacity - 1);
+      while (index[slot] != -1)
+        slot = (slot + 1) & (capacity - 1);
+      index[slot] = i;
+    }
+    free(siteIndex);
+    siteIndex = index;
+    siteIndexCapacity = capacity;
+  }
+
+  uint32_t hash = hashBytes(stack, length);
+  uint32_t slot = hash & (siteIndexCapacity - 1);
+  for (; siteIndex[slot] != -1; slot = (slot + 1) & (siteIndexCapacity - 1))
+  {
+    Site *site = &sites[siteIndex[slot]];
+    if (site->hash == hash && strlen(site->stack) == length &&
+        memcmp(site->stack, stack, length) == 0)
+      return siteIndex[slot];
+  }
+
+  if (siteCount + 1 > siteCapacity)
+  {
+    siteCapacity = GROW_CAPACITY(siteCapacity);
+    sites = (Site *)growOrExit(sites, sizeof(Site) * siteCapacity);
+  }
+  Site *site = &sites[siteCount];
+  site->stack = (char *)growOrExit(NULL, length + 1);
+  memcpy(site->stack, stack, length);
+  site->stack[length] = '\0';
+  site->hash = hash;
+  site->bytes = 0;
+  site->objects = 0;
+  site->liveBytes = 0;
+  site->liveObjects = 0;
+  siteIndex[slot] = siteCount;
+  return siteCount++;
+}
+
+/**
+ * findSample - finds the slot of a sampled object.
+ * @object: the object.
+ * Return: the slot, or the slot it would be added to when it is not
+ * there.
+ */
+static Sample *findSample(Obj *object)
+{
+  uint32_t mask = sampleCapacity - 1;
+  Sample *tombstone = NULL;
+  for (uint32_t slot = hashPointer(object) & mask;; slot = (slot + 1) & mask)
+  {
+    Sample *sample = &samples[slot];
+    if (sample->object == object)
+      return sample;
+    if (sample->object == NULL)
+      return tombstone != NULL ? tombstone : sample;
+    if (sample->object == TOMBSTONE && tombstone == NULL)
+      tombstone = sample;
+  }
+}
+
+/**
+ * addSample - remembers a sampled object until it is freed.
+ * @sample: the sample, its object is not in the table.
+ * Return: nothing.
+ */
+static void addSample(Sample sample)
+{
+  if (sampleUsed + 1 > sampleCapacity / 2)
+  {
+    Sample *old = samples;
+    int oldCapacity = sampleCapacity;
+    // the table only grows when the live samples fill a quarter of it.
+    if (sampleCount + 1 > sampleCapacity / 4)
+      sampleCapacity = GROW_CAPACITY(sampleCapacity);
+    samples = (Sample *)growOrExit(NULL, sizeof(Sample) * sampleCapacity);
+    memset(samples, 0, sizeof(Sample) * sampleCapacity);
+    sampleUsed = sampleCount;
+    for (int i = 0; i < oldCapacity; i++)
+    {
+      if (old[i].object != NULL && old[i].object != TOMBSTONE)
+        *findSample(old[i].object) = old[i];
+    }
+    free(old);
+  }
+
+  Sample *slot = findSample(sample.object);
+  if (slot->object == NULL)
+    sampleUsed++;
+  *slot = sample;
+  sampleCount++;
+}
+
+/**
+ * sampleAllocation - samples a new object that crossed the sample rate,
+ * it stands for the bytes allocated since the last sample. the site is
+ * the stack of the frames that called it, an object the compiler makes
+ * has no frames.
+ * @object: the object.
+ * @size: the size of the object.
+ * Return: nothing.
+ */
+void sampleAllocation(Obj *object, size_t size)
+{
+  size_t past = size - vm.profileCountdown;
+  size_t crossed = 1 + past / sampleBytes;
+  vm.profileCountdown = sampleBytes - past % sampleBytes;
+
+  char stack[PROFILE_STACK_MAX];
+  size_t length = 0;
+  for (int i = 0; i < vm.frameCount; i++)
+  {
+    appendFrame(stack, &length, &vm.frames[i]);
+  }
+  if (length == 0)
+  {
+    memcpy(stack, "<compiler>", 10);
+    length = 10;
+  }
+
+  Sample sample;
+  sample.object = object;
+  sample.site = findSite(stack, length);
+  sample.bytes = (double)(crossed * sampleBytes);
+  sample.objects = sample.bytes / (double)size;
+
+  Site *site = &sites[sample.site];
+  site->bytes += sample.bytes;
+  site->objects += sample.objects;
+  site->liveBytes += sample.bytes;
+  site->liveObjects += sample.objects;
+  object->isSampled = true;
+  addSample(sample);
+}
+
+/**
+ * moveSample - follows a sampled object the collector moved.
+ * @object: where the object was.
+ * @copy: where it is now, it is sampled too.
+ * Return: nothing.
+ */
+void moveSample(Obj *object, Obj *copy)
+{
+  Sample *slot = findSample(object);
+  Sample sample = *slot;
+  slot->object = TOMBSTONE;
+  sampleCount--;
+  sample.object = copy;
+  addSample(sample);
+}
+
+/**
+ * freeSample - forgets a sampled object that was freed, it is no longer
+ * live.
+ * @object: the object.
+ * Return: nothing.
+ */
+void freeSample(Obj *object)
+{
+  Sample *slot = findSample(object);
+  Site *site = &sites[slot->site];
+  site->liveBytes -= slot->bytes;
+  site->liveObjects -= slot->objects;
+  slot->object = TOMBSTONE;
+  sampleCount--;
+}
+
+/**
+ * writeProfile - writes the sites in the folded format flame graph tools
+ * read, a line per stack followed by its value. the four values of a site
+ * are on four lines, the first frame tells them apart: alloc_space and
+ * alloc_objects count everything that was allocated, inuse_space and
+ * inuse_objects what is still alive. the garbage is collected first.
+ * @path: the file to write.
+ * Return: false if the file could not be written.
+ */
+bool writeProfile(const char *path)
+{
+  collectYoung();
+  collectGarbage();
+
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return false;
+
+  static const char *kinds[] = {"alloc_space", "alloc_objects",
+                                "inuse_space", "inuse_objects"};
+  for (int kind = 0; kind < 4; kind++)
+  {
+    for (int i = 0; i < siteCount; i++)
+    {
+      Site *site = &sites[i];
+      double values[] = {site->bytes, site->objects, site->liveBytes, site->liveObjects};
+      long long value = (long long)(values[kind] + 0.5);
+      if (value > 0)
+        fprintf(file, "%s;%s %lld\n", kinds[kind], site->stack, value);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+/**
+ * freeProfile - stops the profiler and frees its tables.
+ * Return: nothing.
+ */
+void freeProfile()
+{
+  vm.profileCountdown = 0;
+  for (int i = 0; i < siteCount; i++)
+  {
+    free(sites[i].stack);
+  }
+  free(sites);
+  free(siteIndex);
+  free(samples);
+  sites = NULL;
+  siteIndex = NULL;
+  samples = NULL;
+  siteCount = siteCapacity = siteIndexCapacity = 0;
+  sampleCount = sampleUsed = sampleCapacity = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef AHADU_PROFILE_H
+#define AHADU_PROFILE_H
+
+#include "common.h"
+#include "object.h"
+#include "vm.h"
+
+// the bytes between two samples when no other rate is given.
+#define PROFILE_SAMPLE_BYTES (512 * 1024)
+
+void startProfile(size_t sampleBytes);
+void sampleAllocation(Obj *object, size_t size);
+void moveSample(Obj *object, Obj *copy);
+void freeSample(Obj *object);
+bool writeProfile(const char *path);
+void freeProfile();
+
+/**
+ * profileAllocation - counts a new object toward the next sample, when
+ * the allocation profiler runs.
+ * @object: the object.
+ * @size: the size of the object.
+ * Return: nothing.
+ */
+static inline void profileAllocation(Obj *object, size_t size)
+{
+  if (vm.profileCountdown == 0)
+    return;
+  if (vm.profileCountdown > size)
+  {
+    vm.profileCountdown -= size;
+    return;
+  }
+  sampleAllocation(object, size);
+}
+
+#endif // !AHADU_PROFILE_H
@@ -4,16 +4,23 @@
 #include "common.h"
 #include "scanner.h"
 
+#define MAX_INTERPOLATION_DEPTH 8
+
 /**
  * @start: the beginning of the current token being read.
  * @current: the current character being looked at.
  * @line: the line of the current token for error reporting.
+ * @interpolationDepth: the number of ${ that are still open.
+ * @braces: the braces opened inside each open ${, its } ends when
+ *          they are all closed.
  */
 typedef struct
 {
   const wchar_t *start;
   const wchar_t *current;
   int line;
+  int interpolationDepth;
+  int braces[MAX_INTERPOLATION_DEPTH];
 } Scanner;
 
 Scanner scanner;
@@ -28,6 +35,7 @@ void initScanner(const wchar_t *source)
   scanner.start = source;
   scanner.current = source;
   scanner.line = 1;
+  scanner.interpolationDepth = 0;
 }
 
 static bool isAlpha(wchar_t c)
@@ -248,13 +256,34 @@ static Token number()
   return makeToken(TOKEN_NUMBER);
 }
 
-// string handles the strings
+/**
+ * string - scans a string literal, or the part of a template string up to
+ * the next ${. "ሰላም ${ስም}!" scans as the interpolation "ሰላም ${, the
+ * tokens of ስም and the string }!". $${ is a literal ${, the compiler drops
+ * the extra $.
+ * Return: the token.
+ */
 static Token string()
 {
   while (peek() != '"' && !isAtEnd())
   {
     if (peek() == '\n')
       scanner.line++;
+    if (peek() == '$' && peekNext() == '$' && scanner.current[2] == '{')
+    {
+      advance();
+      advance();
+    }
+    else if (peek() == '$' && peekNext() == '{')
+    {
+      if (scanner.interpolationDepth == MAX_INTERPOLATION_DEPTH)
+        return errorToken(L"Interpolation is nested too deeply.");
+
+      advance();
+      advance();
+      scanner.braces[scanner.interpolationDepth++] = 0;
+      return makeToken(TOKEN_INTERPOLATION);
+    }
     advance();
   }
 
@@ -288,8 +317,20 @@ Token scanToken()
   case ')':
     return makeToken(TOKEN_RIGHT_PAREN);
   case '{':
+    if (scanner.interpolationDepth > 0)
+      scanner.braces[scanner.interpolationDepth - 1]++;
     return makeToken(TOKEN_LEFT_BRACE);
   case '}':
+    if (scanner.interpolationDepth > 0)
+    {
+      // the } that closes a ${ continues the string.
+      if (scanner.braces[scanner.interpolationDepth - 1] == 0)
+      {
+        scanner.interpolationDepth--;
+        return string();
+      }
+      scanner.braces[scanner.interpolationDepth - 1]--;
+    }
     return makeToken(TOKEN_RIGHT_BRACE);
   case ';':
     return makeToken(TOKEN_SEMICOLON);
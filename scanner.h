@@ -19,6 +19,7 @@ typedef enum {
 
   //literals
   TOKEN_IDENTIFIER, TOKEN_STRING, TOKEN_NUMBER,
+  TOKEN_INTERPOLATION,
 
   //keywords
   TOKEN_AND, TOKEN_CLASS, TOKEN_ELSE, TOKEN_FALSE,
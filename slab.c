@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+
+#define PAGE_SLOTS(page) ((uint8_t *)(page) + sizeof(SlabPage))
+#define PAGE_END(page) ((uint8_t *)(page) + SLAB_PAGE_SIZE)
+
+/**
+ * FreeSlot - a slot that holds no object.
+ * @next: the next free slot of the page.
+ */
+typedef struct FreeSlot
+{
+  struct FreeSlot *next;
+} FreeSlot;
+
+/**
+ * SlabClass - the pages of one object type.
+ * @current: the page new objects are taken from.
+ * @available: the other pages that have free slots.
+ */
+typedef struct
+{
+  SlabPage *current;
+  SlabPage *available;
+} SlabClass;
+
+static SlabClass classes[OBJ_TYPE_COUNT];
+static SlabPage *pages = NULL;
+static SlabPage **sweepLink = NULL;
+static SlabPage *evacuated = NULL;
+
+static void pushAvailable(SlabClass *slabClass, SlabPage *page)
+{
+  page->previousFree = NULL;
+  page->nextFree = slabClass->available;
+  if (slabClass->available != NULL)
+    slabClass->available->previousFree = page;
+  slabClass->available = page;
+  page->isAvailable = true;
+}
+
+static void removeAvailable(SlabClass *slabClass, SlabPage *page)
+{
+  if (page->previousFree != NULL)
+    page->previousFree->nextFree = page->nextFree;
+  else
+    slabClass->available = page->nextFree;
+  if (page->nextFree != NULL)
+    page->nextFree->previousFree = page->previousFree;
+  page->isAvailable = false;
+}
+
+/**
+ * newPage - maps a page for objects of a type. pages are aligned to their
+ * size so the page of an object is found by masking its address.
+ * @type: the type of the objects.
+ * @size: the size of the objects.
+ * Return: the page.
+ */
+static SlabPage *newPage(ObjType type, size_t size)
+{
+  SlabPage *page = (SlabPage *)aligned_alloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+  if (page == NULL)
+    exit(1);
+  page->nextFree = NULL;
+  page->previousFree = NULL;
+  page->freeList = NULL;
+  page->top = PAGE_SLOTS(page);
+  page->slotSize = (uint32_t)((size + 7) & ~(size_t)7);
+  page->live = 0;
+  page->type = type;
+  page->isAvailable = false;
+  memset(page->marks, 0, sizeof(page->marks));
+  memset(page->allocated, 0, sizeof(page->allocated));
+
+  page->next = pages;
+  pages = page;
+  return page;
+}
+
+static inline uint32_t pageSlots(SlabPage *page)
+{
+  return (uint32_t)((PAGE_END(page) - PAGE_SLOTS(page)) / page->slotSize);
+}
+
+static inline bool isFull(SlabPage *page)
+{
+  return page->freeList == NULL && page->top + page->slotSize > PAGE_END(page);
+}
+
+/**
+ * allocateSlab - takes a slot for an object, from a free list or from the
+ * part of a page that was never used. objects of a type share pages.
+ * @type: the type of the object.
+ * @size: the size of the object, the same for every object of the type.
+ * Return: the object, nothing of it is set.
+ */
+Obj *allocateSlab(ObjType type, size_t size)
+{
+  SlabClass *slabClass = &classes[type];
+  SlabPage *page = slabClass->current;
+  if (page == NULL || isFull(page))
+  {
+    page = slabClass->available;
+    if (page != NULL)
+      removeAvailable(slabClass, page);
+    else
+      page = newPage(type, size);
+    slabClass->current = page;
+  }
+
+  Obj *object = (Obj *)page->freeList;
+  if (object != NULL)
+  {
+    page->freeList = page->freeList->next;
+  }
+  else
+  {
+    object = (Obj *)page->top;
+    page->top += page->slotSize;
+  }
+  page->live++;
+  setBit(page->allocated, bitIndex(page, object));
+  return object;
+}
+
+/**
+ * clearSlabMarks - unmarks every old object, before a cycle starts.
+ * Return: nothing.
+ */
+void clearSlabMarks()
+{
+  for (SlabPage *page = pages; page != NULL; page = page->next)
+  {
+    memset(page->marks, 0, sizeof(page->marks));
+  }
+}
+
+/**
+ * startSweep - starts a sweep at the first page of the heap.
+ * Return: nothing.
+ */
+void startSweep()
+{
+  sweepLink = &pages;
+}
+
+/**
+ * sweepPage - frees the objects of a page that hold a slot but are not
+ * marked, a word of the bitmaps at a time. their slots go on the free
+ * list of the page, the live objects are not touched.
+ * @page: the page.
+ * @release: frees an object.
+ * Return: nothing.
+ */
+static void sweepPage(SlabPage *page, ObjectFn release)
+{
+  uint32_t live = 0;
+  for (int i = 0; i < SLAB_BITMAP_WORDS; i++)
+  {
+    uint64_t dead = page->allocated[i] & ~page->marks[i];
+    page->allocated[i] &= ~dead;
+    live += (uint32_t)__builtin_popcountll(page->allocated[i]);
+    while (dead != 0)
+    {
+      Obj *object = (Obj *)((uint8_t *)page + ((size_t)i * 64 + __builtin_ctzll(dead)) * 8);
+      dead &= dead - 1;
+      release(object);
+#ifdef DEBUG_STRESS_GC
+      // a pointer to a freed object now points at garbage.
+      memset(object, 0xdb, page->slotSize);
+#endif
+      FreeSlot *slot = (FreeSlot *)object;
+      slot->next = page->freeList;
+      page->freeList = slot;
+    }
+  }
+  page->live = live;
+}
+
+/**
+ * sweepNextPage - sweeps the next page. a page left empty is given back,
+ * unless new objects are being taken from it.
+ * @release: frees an object.
+ * Return: false when there was no page left to sweep.
+ */
+bool sweepNextPage(ObjectFn release)
+{
+  SlabPage *page = *sweepLink;
+  if (page == NULL)
+    return false;
+
+  sweepPage(page, release);
+  SlabClass *slabClass = &classes[page->type];
+  if (page->live == 0 && page != slabClass->current)
+  {
+    if (page->isAvailable)
+      removeAvailable(slabClass, page);
+    *sweepLink = page->next;
+    free(page);
+    return true;
+  }
+
+  if (page->freeList != NULL && page != slabClass->current && !page->isAvailable)
+    pushAvailable(slabClass, page);
+  sweepLink = &page->next;
+  return true;
+}
+
+/**
+ * slabUsage - how much of the pages holds objects.
+ * @used: set to the bytes of the slots that hold objects.
+ * @total: set to the bytes of the pages.
+ * Return: nothing.
+ */
+void slabUsage(size_t *used, size_t *total)
+{
+  *used = 0;
+  *total = 0;
+  for (SlabPage *page = pages; page != NULL; page = page->next)
+  {
+    *used += (size_t)page->live * page->slotSize;
+    *total += SLAB_PAGE_SIZE;
+  }
+}
+
+static inline bool isSparse(SlabPage *page)
+{
+  return page->live * 2 < pageSlots(page);
+}
+
+/**
+ * startEvacuation - picks the pages to empty. a page less than half full
+ * is picked if the objects of the sparse pages of its type fit in fewer
+ * pages. the picked pages leave the heap, no object is taken from them.
+ * Return: true if a page was picked.
+ */
+bool startEvacuation()
+{
+  uint32_t sparsePages[OBJ_TYPE_COUNT] = {0};
+  uint32_t sparseLive[OBJ_TYPE_COUNT] = {0};
+  uint32_t slots[OBJ_TYPE_COUNT] = {0};
+  for (SlabPage *page = pages; page != NULL; page = page->next)
+  {
+    if (!isSparse(page))
+      continue;
+    sparsePages[page->type]++;
+    sparseLive[page->type] += page->live;
+    slots[page->type] = pageSlots(page);
+  }
+
+  bool evacuate[OBJ_TYPE_COUNT];
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+  {
+    uint32_t needed = slots[i] == 0 ? 0 : (sparseLive[i] + slots[i] - 1) / slots[i];
+    evacuate[i] = needed < sparsePages[i];
+  }
+
+  SlabPage **link = &pages;
+  while (*link != NULL)
+  {
+    SlabPage *page = *link;
+    if (!evacuate[page->type] || !isSparse(page))
+    {
+      link = &page->next;
+      continue;
+    }
+
+    SlabClass *slabClass = &classes[page->type];
+    if (page == slabClass->current)
+      slabClass->current = NULL;
+    if (page->isAvailable)
+      removeAvailable(slabClass, page);
+    *link = page->next;
+    page->next = evacuated;
+    evacuated = page;
+  }
+  return evacuated != NULL;
+}
+
+/**
+ * forEachInPage - calls a function with the objects of a page.
+ * @page: the page.
+ * @function: the function.
+ * Return: nothing.
+ */
+static void forEachInPage(SlabPage *page, ObjectFn function)
+{
+  for (int i = 0; i < SLAB_BITMAP_WORDS; i++)
+  {
+    uint64_t objects = page->allocated[i];
+    while (objects != 0)
+    {
+      function((Obj *)((uint8_t *)page + ((size_t)i * 64 + __builtin_ctzll(objects)) * 8));
+      objects &= objects - 1;
+    }
+  }
+}
+
+/**
+ * forEachEvacuated - calls a function with the objects of the pages that
+ * are being emptied.
+ * @function: the function.
+ * Return: nothing.
+ */
+void forEachEvacuated(ObjectFn function)
+{
+  for (SlabPage *page = evacuated; page != NULL; page = page->next)
+  {
+    forEachInPage(page, function);
+  }
+}
+
+/**
+ * forEachObject - calls a function with the objects of the heap.
+ * @function: the function.
+ * Return: nothing.
+ */
+void forEachObject(ObjectFn function)
+{
+  for (SlabPage *page = pages; page != NULL; page = page->next)
+  {
+    forEachInPage(page, function);
+  }
+}
+
+/**
+ * finishEvacuation - gives back the emptied pages, nothing may point into
+ * them any more.
+ * Return: nothing.
+ */
+void finishEvacuation()
+{
+  while (evacuated != NULL)
+  {
+    SlabPage *next = evacuated->next;
+    free(evacuated);
+    evacuated = next;
+  }
+}
+
+/**
+ * freeSlabs - releases every object and gives back every page.
+ * @release: frees an object.
+ * Return: nothing.
+ */
+void freeSlabs(ObjectFn release)
+{
+  SlabPage *page = pages;
+  while (page != NULL)
+  {
+    SlabPage *next = page->next;
+    memset(page->marks, 0, sizeof(page->marks));
+    sweepPage(page, release);
+    free(page);
+    page = next;
+  }
+  pages = NULL;
+  sweepLink = NULL;
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+  {
+    classes[i].current = NULL;
+    classes[i].available = NULL;
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef AHADU_SLAB_H
+#define AHADU_SLAB_H
+
+#include "common.h"
+#include "object.h"
+
+#define SLAB_PAGE_SIZE (32 * 1024)
+
+// one bit of a bitmap stands for 8 bytes, every object starts on one.
+#define BITMAP_WORDS(bytes) ((bytes) / 8 / 64)
+#define SLAB_BITMAP_WORDS BITMAP_WORDS(SLAB_PAGE_SIZE)
+
+/**
+ * ObjectFn - a function called with objects of the heap.
+ * @object: the object.
+ * Return: nothing.
+ */
+typedef void (*ObjectFn)(Obj *object);
+
+/**
+ * SlabPage - a page of equal sized slots that hold objects of one type.
+ * the slots start right after the header. the mark bits live in the
+ * header too, marking and sweeping do not write to live objects.
+ * @next: the next page of the heap, in the order the sweep visits them.
+ * @nextFree: the next page of the same type that has free slots.
+ * @previousFree: the previous page of the same type that has free slots.
+ * @freeList: the free slots, linked through their first word.
+ * @top: the slots from here on were never handed out.
+ * @slotSize: the size of a slot.
+ * @live: the number of slots that hold objects.
+ * @type: the type of the objects.
+ * @isAvailable: whether the page is in the free pages of its type.
+ * @marks: the objects marked in the current cycle.
+ * @allocated: the slots that hold objects.
+ */
+typedef struct SlabPage
+{
+  struct SlabPage *next;
+  struct SlabPage *nextFree;
+  struct SlabPage *previousFree;
+  struct FreeSlot *freeList;
+  uint8_t *top;
+  uint32_t slotSize;
+  uint32_t live;
+  ObjType type;
+  bool isAvailable;
+  uint64_t marks[SLAB_BITMAP_WORDS];
+  uint64_t allocated[SLAB_BITMAP_WORDS];
+} SlabPage;
+
+Obj *allocateSlab(ObjType type, size_t size);
+void clearSlabMarks();
+void startSweep();
+bool sweepNextPage(ObjectFn release);
+void slabUsage(size_t *used, size_t *total);
+bool startEvacuation();
+void forEachEvacuated(ObjectFn function);
+void forEachObject(ObjectFn function);
+void finishEvacuation();
+void freeSlabs(ObjectFn release);
+
+/**
+ * slabPage - the page an old object lives in.
+ * @object: the object.
+ * Return: the page.
+ */
+static inline SlabPage *slabPage(Obj *object)
+{
+  return (SlabPage *)((uintptr_t)object & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+/**
+ * bitIndex - the bit of an object in the bitmap of a region.
+ * @base: the start of the region.
+ * @object: the object.
+ * Return: the index of the bit.
+ */
+static inline size_t bitIndex(const void *base, Obj *object)
+{
+  return (size_t)((uint8_t *)object - (uint8_t *)base) / 8;
+}
+
+static inline bool testBit(const uint64_t *bitmap, size_t index)
+{
+  return (bitmap[index / 64] >> (index % 64)) & 1;
+}
+
+static inline void setBit(uint64_t *bitmap, size_t index)
+{
+  bitmap[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+#endif // !AHADU_SLAB_H
@@ -0,0 +1,267 @@
+#include <string.h>
+#include <wchar.h>
+
+#include "memory.h"
+#include "object.h"
+#include "stats.h"
+#include "table.h"
+#include "vm.h"
+
+// the names of the types, in the order of ObjType.
+static const wchar_t *typeNames[OBJ_TYPE_COUNT] = {
+  [OBJ_BOUND_METHOD] = L"የታሰሩ_ዘዴዎች",
+  [OBJ_CLASS] = L"ክፍሎች",
+  [OBJ_INSTANCE] = L"ቅጽበቶች",
+  [OBJ_LIST] = L"ዝርዝሮች",
+  [OBJ_CLOSURE] = L"መዝጊያዎች",
+  [OBJ_FUNCTION] = L"ተግባሮች",
+  [OBJ_NATIVE] = L"ቤተኛ_ተግባሮች",
+  [OBJ_STRING] = L"ሕብረቁምፊዎች",
+  [OBJ_UPVALUE] = L"ላይ_እሴቶች",
+  [OBJ_WEAK_REF] = L"ደካማ_ማጣቀሻዎች",
+  [OBJ_WEAK_MAP] = L"ደካማ_ካርታዎች",
+};
+
+// the counts forEachObject() adds to.
+static TypeStats *counting;
+
+/**
+ * blockSize - the bytes a block is counted as, a large block takes whole
+ * pages.
+ * @size: the size the block was allocated with.
+ * Return: the size.
+ */
+static size_t blockSize(size_t size)
+{
+  return size >= LARGE_OBJECT_SIZE ? pageRound(size) : size;
+}
+
+/**
+ * ownedSize - the memory an object owns outside of its struct, what
+ * releaseObject() gives back.
+ * @object: the object.
+ * Return: the size in bytes.
+ */
+size_t ownedSize(Obj *object)
+{
+  switch (object->type)
+  {
+  case OBJ_CLASS:
+    return tableSize(&((ObjClass *)object)->methods);
+  case OBJ_CLOSURE:
+    return blockSize(sizeof(Value) * ((ObjClosure *)object)->upvalueCount);
+  case OBJ_FUNCTION:
+  {
+    Chunk *chunk = &((ObjFunction *)object)->chunk;
+    return blockSize(chunk->capacity) + blockSize(sizeof(int) * chunk->capacity) +
+           blockSize(sizeof(Value) * chunk->constants.capacity);
+  }
+  case OBJ_INSTANCE:
+    return tableSize(&((ObjInstance *)object)->fields);
+  case OBJ_LIST:
+    return blockSize(sizeof(Value) * ((ObjList *)object)->items.capacity);
+  case OBJ_STRING:
+  {
+    ObjString *string = (ObjString *)object;
+    size_t size = sizeof(wchar_t) * (string->length + 1);
+    if (string->kind == STRING_HEAP)
+      return blockSize(size);
+    if (string->kind == STRING_MAPPED)
+      return pageRound(size);
+    return 0;
+  }
+  case OBJ_WEAK_MAP:
+    return blockSize(sizeof(WeakEntry) * ((ObjWeakMap *)object)->capacity);
+  case OBJ_BOUND_METHOD:
+  case OBJ_NATIVE:
+  case OBJ_UPVALUE:
+  case OBJ_WEAK_REF:
+    break;
+  }
+  return 0;
+}
+
+static void countObject(Obj *object)
+{
+  // a dead object waits for the sweep, it is not counted.
+  if (isObjectDead(object))
+    return;
+  TypeStats *stats = &counting[object->type];
+  stats->count++;
+  stats->bytes += objectSize(object) + ownedSize(object);
+}
+
+/**
+ * countObjects - counts the objects of each type in the heap and the
+ * bytes they take. the young objects are counted until the young
+ * collection that frees the dead ones.
+ * @stats: the counts, indexed by ObjType.
+ * Return: nothing.
+ */
+void countObjects(TypeStats stats[OBJ_TYPE_COUNT])
+{
+  memset(stats, 0, sizeof(TypeStats) * OBJ_TYPE_COUNT);
+  counting = stats;
+  forEachObject(countObject);
+  for (uint8_t *cursor = vm.nurseryStart; cursor < vm.nurseryTop;)
+  {
+    Obj *young = (Obj *)cursor;
+    cursor += (objectSize(young) + 7) & ~(size_t)7;
+    countObject(young);
+  }
+  counting = NULL;
+}
+
+/**
+ * printGcStats - prints the counters of the collector and the objects
+ * of the heap.
+ * @file: where to print.
+ * Return: nothing.
+ */
+void printGcStats(FILE *file)
+{
+  GcStats *gc = &vm.gcStats;
+  fwprintf(file, L"-- የክምር መረጃ\n");
+  fwprintf(file, L"ስብስቦች %zu\n", gc->cycles);
+  fwprintf(file, L"ትንሽ_ስብስቦች %zu\n", gc->youngCollections);
+  fwprintf(file, L"ማጥበቢያዎች %zu\n", gc->compactions);
+  fwprintf(file, L"ማቆሚያዎች %zu\n", gc->pauses);
+  fwprintf(file, L"ጠቅላላ_ማቆሚያ %.6f\n", gc->pauseTotal / 1e9);
+  fwprintf(file, L"ረጅሙ_ማቆሚያ %.6f\n", gc->pauseMax / 1e9);
+  for (int i = 0; i < GC_PAUSE_BUCKETS; i++)
+  {
+    if (gc->pauseHistogram[i] == 0)
+      continue;
+    if (i == GC_PAUSE_BUCKETS - 1)
+      fwprintf(file, L"  >=%luus %zu\n", 1ul << (i - 1), gc->pauseHistogram[i]);
+    else
+      fwprintf(file, L"  <%luus %zu\n", 1ul << i, gc->pauseHistogram[i]);
+  }
+  fwprintf(file, L"የተለቀቁ_ባይቶች %zu\n", gc->freedBytes);
+  fwprintf(file, L"ባይቶች %zu\n", vm.bytesAllocated);
+  fwprintf(file, L"ትልቅ_ባይቶች %zu\n", vm.largeBytes);
+  fwprintf(file, L"የሕብረቁምፊ_ሰንጠረዥ %d\n", vm.strings.count);
+  fwprintf(file, L"የሕብረቁምፊ_ቦታዎች %d\n", vm.strings.capacity + 1);
+  fwprintf(file, L"የተሰረዙ_ቦታዎች %d\n", vm.strings.tombstones);
+
+  TypeStats stats[OBJ_TYPE_COUNT];
+  countObjects(stats);
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+  {
+    fwprintf(file, L"%ls %zu %zu\n", typeNames[i], stats[i].count, stats[i].bytes);
+  }
+}
+
+/**
+ * setField - sets a field of an instance, the name is made into a string.
+ * the instance has to be reachable.
+ * @instance: the instance.
+ * @name: the name of the field.
+ * @value: the value, it is kept on the stack while the name is made.
+ * Return: nothing.
+ */
+static void setField(ObjInstance *instance, const wchar_t *name, Value value)
+{
+  push(value);
+  push(OBJ_VAL(copyString(name, wcslen(name))));
+  tableSet(&instance->fields, AS_STRING(vm.stackTop[-1]), value);
+  writeBarrier((Obj *)instance, vm.stackTop[-1]);
+  writeBarrier((Obj *)instance, value);
+  pop();
+  pop();
+}
+
+/**
+ * newRecord - makes an instance of a class with no methods, it is pushed
+ * on the stack.
+ * @name: the name of the class.
+ * Return: the instance.
+ */
+static ObjInstance *newRecord(const wchar_t *name)
+{
+  push(OBJ_VAL(copyString(name, wcslen(name))));
+  push(OBJ_VAL(newClass(AS_STRING(vm.stackTop[-1]))));
+  ObjInstance *instance = newInstance(AS_CLASS(vm.stackTop[-1]));
+  pop();
+  pop();
+  push(OBJ_VAL(instance));
+  return instance;
+}
+
+/**
+ * appendNumber - appends a number to a list.
+ * @list: the list, it has to be reachable.
+ * @number: the number.
+ * Return: nothing.
+ */
+static void appendNumber(ObjList *list, double number)
+{
+  writeValueArray(&list->items, NUMBER_VAL(number));
+}
+
+/**
+ * heapStatsNative - the counters of the collector and the objects of
+ * the heap, as the fields of an instance. a type maps to a list of its
+ * count and its bytes, the pause histogram is a list of the buckets.
+ * @argCount: the number of arguments.
+ * @args: the arguments.
+ * Return: true.
+ */
+static bool heapStatsNative(int argCount, Value *args)
+{
+  // the counts are read before anything is allocated for the result.
+  GcStats gc = vm.gcStats;
+  size_t bytes = vm.bytesAllocated;
+  size_t largeBytes = vm.largeBytes;
+  Table strings = vm.strings;
+  TypeStats stats[OBJ_TYPE_COUNT];
+  countObjects(stats);
+
+  ObjInstance *result = newRecord(L"የክምር_መረጃ");
+  setField(result, L"ስብስቦች", NUMBER_VAL(gc.cycles));
+  setField(result, L"ትንሽ_ስብስቦች", NUMBER_VAL(gc.youngCollections));
+  setField(result, L"ማጥበቢያዎች", NUMBER_VAL(gc.compactions));
+  setField(result, L"ማቆሚያዎች", NUMBER_VAL(gc.pauses));
+  setField(result, L"ጠቅላላ_ማቆሚያ", NUMBER_VAL(gc.pauseTotal / 1e9));
+  setField(result, L"ረጅሙ_ማቆሚያ", NUMBER_VAL(gc.pauseMax / 1e9));
+  setField(result, L"የተለቀቁ_ባይቶች", NUMBER_VAL(gc.freedBytes));
+  setField(result, L"ባይቶች", NUMBER_VAL(bytes));
+  setField(result, L"ትልቅ_ባይቶች", NUMBER_VAL(largeBytes));
+  setField(result, L"የሕብረቁምፊ_ሰንጠረዥ", NUMBER_VAL(strings.count));
+  setField(result, L"የሕብረቁምፊ_ቦታዎች", NUMBER_VAL(strings.capacity + 1));
+  setField(result, L"የተሰረዙ_ቦታዎች", NUMBER_VAL(strings.tombstones));
+
+  ObjList *histogram = newList();
+  push(OBJ_VAL(histogram));
+  for (int i = 0; i < GC_PAUSE_BUCKETS; i++)
+  {
+    appendNumber(histogram, gc.pauseHistogram[i]);
+  }
+  setField(result, L"የማቆሚያ_ስርጭት", OBJ_VAL(histogram));
+  pop();
+
+  ObjInstance *types = newRecord(L"አይነቶች");
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+  {
+    ObjList *type = newList();
+    push(OBJ_VAL(type));
+    appendNumber(type, stats[i].count);
+    appendNumber(type, stats[i].bytes);
+    setField(types, typeNames[i], OBJ_VAL(type));
+    pop();
+  }
+  setField(result, L"አይነቶች", OBJ_VAL(types));
+  pop();
+
+  args[-1] = pop();
+  return true;
+}
+
+/**
+ * initStatsNatives - defines the heap statistics natives.
+ * Return: nothing.
+ */
+void initStatsNatives()
+{
+  defineNative(L"የክምር_መረጃ", 0, heapStatsNative);
+}
@@ -0,0 +1,24 @@
+#ifndef AHADU_STATS_H
+#define AHADU_STATS_H
+
+#include <stdio.h>
+
+#include "common.h"
+#include "object.h"
+
+/**
+ * TypeStats - the objects of one type that are alive.
+ * @count: the number of objects.
+ * @bytes: the bytes of the objects, with the memory they own.
+ */
+typedef struct {
+  size_t count;
+  size_t bytes;
+} TypeStats;
+
+size_t ownedSize(Obj *object);
+void countObjects(TypeStats stats[OBJ_TYPE_COUNT]);
+void printGcStats(FILE *file);
+void initStatsNatives();
+
+#endif // !AHADU_STATS_H
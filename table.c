@@ -1,5 +1,10 @@
 #include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "memory.h"
 #include "object.h"
@@ -7,6 +12,80 @@
 #include "value.h"
 
 #define TABLE_MAX_LOAD 0.75
+#define TABLE_MIN_SLOTS 8
+
+/*
+ * the table is a swiss table: next to the entries there is one control
+ * byte per slot. a full slot stores the low 7 bits of the key's hash,
+ * empty and deleted slots store negative markers. a probe loads a group
+ * of 16 control bytes and compares them all at once, so the entries are
+ * only touched when the 7 bits already match.
+ *
+ * the control bytes are followed by a copy of the first GROUP_WIDTH of
+ * them, a group that starts near the end reads on into the start.
+ */
+#define GROUP_WIDTH 16
+#define CONTROL_EMPTY ((int8_t)-128)
+#define CONTROL_DELETED ((int8_t)-2)
+
+#define HASH_POSITION(hash) ((hash) >> 7)
+#define HASH_CONTROL(hash) ((int8_t)((hash) & 0x7F))
+
+/**
+  * matchControl - finds the control bytes of a group equal to a byte.
+  * @group: the first control byte of the group.
+  * @control: the byte to look for.
+  * Return: bit i is set if byte i of the group matches.
+  */
+static inline uint32_t matchControl(const int8_t *group, int8_t control) {
+#ifdef __SSE2__
+  __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(control)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) {
+    if (group[i] == control) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+  * matchFree - finds the empty and deleted slots of a group.
+  * @group: the first control byte of the group.
+  * Return: bit i is set if slot i of the group can take a new key.
+  */
+static inline uint32_t matchFree(const int8_t *group) {
+#ifdef __SSE2__
+  __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmplt_epi8(bytes, _mm_set1_epi8(-1)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) {
+    if (group[i] < -1) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+  * tableBytes - the size of the block that holds the entries and the
+  * control bytes of a table.
+  * @slots: the number of slots.
+  * Return: the size in bytes.
+  */
+static size_t tableBytes(int slots) {
+  return (size_t)slots * sizeof(Entry) + slots + GROUP_WIDTH;
+}
+
+/**
+  * tableSize - the memory the slots of a table take.
+  * @table: the table.
+  * Return: the size in bytes.
+  */
+size_t tableSize(Table *table) {
+  return table->entries == NULL ? 0 : tableBytes(table->capacity + 1);
+}
 
 /**
   * initTable - initializes a table.
@@ -15,8 +94,10 @@
   */
 void initTable(Table *table) {
   table->count = 0;
+  table->tombstones = 0;
   table->capacity = -1;
   table->entries = NULL;
+  table->control = NULL;
 }
 
 /**
@@ -25,38 +106,73 @@ void initTable(Table *table) {
   * Return: nothing.
   */
 void freeTable(Table *table) {
-  FREE_ARRAY(Entry, table->entries, table->capacity + 1);
+  if (table->entries != NULL) {
+    FREE_ARRAY(uint8_t, (uint8_t *)table->entries, tableBytes(table->capacity + 1));
+  }
   initTable(table);
 }
 
 /**
-  * findEntry - finds an entry in a table.
-  * @entries: the entries to search.
-  * @capacity: the capacity of the table.
+  * setControl - sets the control byte of a slot and of its copy.
+  * @table: the table.
+  * @index: the slot.
+  * @control: the new control byte.
+  * Return: nothing.
+  */
+static inline void setControl(Table *table, uint32_t index, int8_t control) {
+  int slots = table->capacity + 1;
+  table->control[index] = control;
+  // a table smaller than a group repeats its bytes to fill the group.
+  for (int i = index + slots; i < slots + GROUP_WIDTH; i += slots) {
+    table->control[i] = control;
+  }
+}
+
+/**
+  * findIndex - finds the slot of a key.
+  * @table: the table to search.
   * @key: the key to search for.
-  * Return: the entry.
-  */
-static Entry *findEntry(Entry *entries, int capacity, ObjString *key) {
-  uint32_t index = key->hash & capacity; // using modulo to shrink the hash into the size of the array is slow thats why i am using bitwise operator and to manioulate the bits.
-  Entry *tombstone = NULL;
-
-  for (;;) {
-    Entry *entry = &entries[index];
-
-    if (entry->key == NULL) {
-      if (IS_NIL(entry->value)) {
-        // Empty entry.
-        return tombstone != NULL ? tombstone : entry;
-      } else {
-        // Found tombstone.
-        if (tombstone == NULL) tombstone = entry;
-      }
-    } else if (entry->key == key) {
-      // found the key.
-      return entry;
+  * Return: the slot, or -1 if the key is not in the table.
+  */
+static inline int findIndex(Table *table, ObjString *key) {
+  const int8_t *controls = table->control;
+  const Entry *entries = table->entries;
+  uint32_t mask = (uint32_t)table->capacity;
+  uint32_t position = HASH_POSITION(key->hash) & mask;
+  int8_t control = HASH_CONTROL(key->hash);
+
+  // most keys sit in the slot their hash points at.
+  if (entries[position].key == key) return (int)position;
+
+  for (uint32_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+    const int8_t *group = controls + position;
+    for (uint32_t match = matchControl(group, control); match != 0; match &= match - 1) {
+      uint32_t index = (position + __builtin_ctz(match)) & mask;
+      if (entries[index].key == key) return (int)index;
     }
+    // a key is never stored past an empty slot.
+    if (matchControl(group, CONTROL_EMPTY) != 0) return -1;
 
-    index = (index + 1) & capacity;
+    position = (position + step) & mask;
+  }
+}
+
+/**
+  * findFree - finds the first empty or deleted slot on the probe path of
+  * a hash.
+  * @table: the table, it must have a free slot.
+  * @hash: the hash of the key.
+  * Return: the slot.
+  */
+static uint32_t findFree(Table *table, uint32_t hash) {
+  uint32_t mask = (uint32_t)table->capacity;
+  uint32_t position = HASH_POSITION(hash) & mask;
+
+  for (uint32_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+    uint32_t match = matchFree(table->control + position);
+    if (match != 0) return (position + __builtin_ctz(match)) & mask;
+
+    position = (position + step) & mask;
   }
 }
 
@@ -68,43 +184,117 @@ static Entry *findEntry(Entry *entries, int capacity, ObjString *key) {
   * Return: true if the value is found, false otherwise.
   */
 bool tableGet(Table *table, ObjString *key, Value *value) {
-  if (table->entries == NULL) return false;
+  if (table->count == 0) return false;
 
-  Entry *entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL) return false;
+  int index = findIndex(table, key);
+  if (index < 0) return false;
 
-  *value = entry->value;
+  *value = table->entries[index].value;
   return true;
 }
 
 /**
-  * adjustCapacity - adjusts the capacity of a table.
+  * adjustCapacity - adjusts the capacity of a table. the entries move to a
+  * new block, it takes the place of the old one under the lock of the
+  * background marker, which may be reading the old one until then.
   * @table: the table to adjust.
   * @capacity: the new capacity.
   * Return: nothing.
   */
 static void adjustCapacity(Table *table, int capacity) {
-  Entry *entries = ALLOCATE(Entry, capacity + 1);
-  for (int i = 0; i <= capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].value = NIL_VAL;
+  int slots = capacity + 1;
+  uint8_t *block = ALLOCATE(uint8_t, tableBytes(slots));
+
+  Table resized;
+  resized.count = 0;
+  resized.tombstones = 0;
+  resized.capacity = capacity;
+  resized.entries = (Entry *)block;
+  resized.control = (int8_t *)(block + (size_t)slots * sizeof(Entry));
+  memset(resized.control, CONTROL_EMPTY, slots + GROUP_WIDTH);
+  for (int i = 0; i < slots; i++) {
+    resized.entries[i].key = NULL;
+    resized.entries[i].value = NIL_VAL;
   }
 
-  table->count = 0;
   for (int i = 0; i <= table->capacity; i++) {
     Entry *entry = &table->entries[i];
     if (entry->key == NULL) continue;
 
-    Entry *dest = findEntry(entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = entry->value;
-    table->count++;
+    uint32_t index = findFree(&resized, entry->key->hash);
+    setControl(&resized, index, HASH_CONTROL(entry->key->hash));
+    resized.entries[index] = *entry;
+    resized.count++;
   }
 
-  FREE_ARRAY(Entry, table->entries, table->capacity + 1);
+  Table old = *table;
+  bool locked = lockHeap();
+  *table = resized;
+  unlockHeap(locked);
+  freeTable(&old);
+}
+
+/**
+  * tableReserve - makes room for a number of keys, so that setting them
+  * does not grow the table.
+  * @table: the table.
+  * @count: the number of keys.
+  * Return: nothing.
+  */
+void tableReserve(Table *table, int count) {
+  int slots = TABLE_MIN_SLOTS;
+  while (count > slots * TABLE_MAX_LOAD) slots *= 2;
+  if (slots > table->capacity + 1) adjustCapacity(table, slots - 1);
+}
+
+/**
+  * rehashInPlace - drops the tombstones of a table without allocating.
+  * every key is first marked deleted, then moved to the first free slot of
+  * its probe path, swapping with keys that still have to be placed.
+  * @table: the table.
+  * Return: nothing.
+  */
+static void rehashInPlace(Table *table) {
+  int slots = table->capacity + 1;
+  uint32_t mask = (uint32_t)table->capacity;
+
+  for (int i = 0; i < slots; i++) {
+    table->control[i] = table->control[i] >= 0 ? CONTROL_DELETED : CONTROL_EMPTY;
+  }
+  for (int i = slots; i < slots + GROUP_WIDTH; i++) {
+    table->control[i] = table->control[(i - slots) & mask];
+  }
+
+  for (uint32_t i = 0; i < (uint32_t)slots; i++) {
+    if (table->control[i] != CONTROL_DELETED) continue;
+
+    uint32_t hash = table->entries[i].key->hash;
+    uint32_t target = findFree(table, hash);
+    uint32_t home = HASH_POSITION(hash) & mask;
+
+    // the key is already in the group a lookup would find it in.
+    if (((i - home) & mask) / GROUP_WIDTH == ((target - home) & mask) / GROUP_WIDTH) {
+      setControl(table, i, HASH_CONTROL(hash));
+      continue;
+    }
 
-  table->entries = entries;
-  table->capacity = capacity;
+    bool targetEmpty = table->control[target] == CONTROL_EMPTY;
+    setControl(table, target, HASH_CONTROL(hash));
+    if (targetEmpty) {
+      table->entries[target] = table->entries[i];
+      table->entries[i].key = NULL;
+      table->entries[i].value = NIL_VAL;
+      setControl(table, i, CONTROL_EMPTY);
+    } else {
+      Entry placed = table->entries[i];
+      table->entries[i] = table->entries[target];
+      table->entries[target] = placed;
+      // the key swapped in still has to be placed.
+      i--;
+    }
+  }
+
+  table->tombstones = 0;
 }
 
 /**
@@ -115,18 +305,59 @@ static void adjustCapacity(Table *table, int capacity) {
   * Return: true if the key is new, false otherwise.
   */
 bool tableSet(Table *table, ObjString *key, Value value) {
-  if (table->count + 1 > (table->capacity + 1) * TABLE_MAX_LOAD) {
-    int capacity = GROW_CAPACITY(table->capacity + 1) - 1;
-    adjustCapacity(table, capacity);
+  int index = table->count == 0 ? -1 : findIndex(table, key);
+  if (index >= 0) {
+    bool locked = lockHeap();
+    table->entries[index].value = value;
+    unlockHeap(locked);
+    return false;
   }
 
-  Entry *entry = findEntry(table->entries, table->capacity, key);
-  bool isNewKey = entry->key == NULL;
-  if (isNewKey && IS_NIL(entry->value)) table->count++;
+  int slots = table->capacity + 1;
+  if (table->count + table->tombstones + 1 > slots * TABLE_MAX_LOAD) {
+    // when at least half of the load is tombstones, dropping them is enough.
+    bool dropTombstones = (table->count + 1) * 2 <= slots * TABLE_MAX_LOAD;
+    if (dropTombstones && !markingConcurrently()) {
+      rehashInPlace(table);
+    } else {
+      // a background marker may be reading the entries, they only move to
+      // a new block then.
+      adjustCapacity(table, dropTombstones ? table->capacity : GROW_CAPACITY(slots) - 1);
+    }
+  }
 
-  entry->key = key;
-  entry->value = value;
-  return isNewKey;
+  uint32_t slot = findFree(table, key->hash);
+  if (table->control[slot] == CONTROL_DELETED) table->tombstones--;
+  table->count++;
+
+  setControl(table, slot, HASH_CONTROL(key->hash));
+  bool locked = lockHeap();
+  table->entries[slot].key = key;
+  table->entries[slot].value = value;
+  unlockHeap(locked);
+  return true;
+}
+
+/**
+  * wasNeverFull - whether a slot can become empty again instead of a
+  * tombstone. that is the case when no lookup could have probed past it:
+  * every group of 16 that holds the slot also holds an empty slot.
+  * @table: the table.
+  * @index: the slot.
+  * Return: true if the slot can be marked empty.
+  */
+static bool wasNeverFull(Table *table, uint32_t index) {
+  uint32_t mask = (uint32_t)table->capacity;
+  // a group that covers the whole table always holds an empty slot.
+  if (mask + 1 <= GROUP_WIDTH) return true;
+
+  uint32_t before = matchControl(table->control + ((index - GROUP_WIDTH) & mask), CONTROL_EMPTY);
+  uint32_t after = matchControl(table->control + index, CONTROL_EMPTY);
+  if (before == 0 || after == 0) return false;
+
+  int emptyBefore = __builtin_clz(before) - (32 - GROUP_WIDTH);
+  int emptyAfter = __builtin_ctz(after);
+  return emptyBefore + emptyAfter < GROUP_WIDTH;
 }
 
 /**
@@ -138,14 +369,21 @@ bool tableSet(Table *table, ObjString *key, Value value) {
 bool tableDelete(Table *table, ObjString *key) {
   if (table->count == 0) return false;
 
-  // Find the entry.
-  Entry *entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL) return false;
-
-  // Place a tombstone in the entry.
-  entry->key = NULL;
-  entry->value = BOOL_VAL(true);
+  int index = findIndex(table, key);
+  if (index < 0) return false;
 
+  table->count--;
+  if (wasNeverFull(table, index)) {
+    setControl(table, index, CONTROL_EMPTY);
+  } else {
+    // leave a tombstone so the keys after it can still be found.
+    setControl(table, index, CONTROL_DELETED);
+    table->tombstones++;
+  }
+  bool locked = lockHeap();
+  table->entries[index].key = NULL;
+  table->entries[index].value = NIL_VAL;
+  unlockHeap(locked);
   return true;
 }
 
@@ -170,39 +408,58 @@ void tableAddAll(Table *from, Table *to) {
   * @chars: the characters to search for.
   * @length: the length of the characters.
   * @hash: the hash of the characters.
-  * Return: the string if found, NULL otherwise.
+  * Return: the string if found, NULL otherwise. strings that wait to be
+  * swept are not found, an equal one is made instead.
   */
 ObjString *tableFindString(Table *table, const wchar_t *chars, int length, uint32_t hash) {
   if (table->count == 0) return NULL;
 
-  uint32_t index = hash & table->capacity;
-
-  for (;;) {
-    Entry *entry = &table->entries[index];
+  uint32_t mask = (uint32_t)table->capacity;
+  uint32_t position = HASH_POSITION(hash) & mask;
+  int8_t control = HASH_CONTROL(hash);
 
-    if (entry->key == NULL) {
-      if (IS_NIL(entry->value)) {
-        // Empty entry.
-        return NULL;
+  for (uint32_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+    const int8_t *group = table->control + position;
+    for (uint32_t match = matchControl(group, control); match != 0; match &= match - 1) {
+      ObjString *key = table->entries[(position + __builtin_ctz(match)) & mask].key;
+      // a dead string may point into a buffer that is already swept.
+      if (key->hash == hash && key->length == length && !isObjectDead(&key->obj) &&
+          wmemcmp(key->chars, chars, length) == 0) {
+        return key;
       }
-    } else if (entry->key->length == length &&
-               entry->key->hash == hash &&
-               memcmp(entry->key->chars, chars, length) == 0) {
-      // Found it.
-      return entry->key;
     }
+    if (matchControl(group, CONTROL_EMPTY) != 0) return NULL;
 
-    index = (index + 1) & table->capacity;
+    position = (position + step) & mask;
   }
 }
 
-void tableRemoveWhite(Table *table) {
-  for (int i = 0; i <= table->capacity; i++) {
-    Entry *entry = &table->entries[i];
-    if (entry->key != NULL && !entry->key->obj.isMarked) {
-      tableDelete(table, entry->key);
-    }
+/**
+  * tableCompact - gives back the memory of a table that lost most of its
+  * keys, and drops its tombstones. it is run after a collection so tables
+  * like the strings keep short probes in long running programs.
+  * @table: the table.
+  * Return: nothing.
+  */
+void tableCompact(Table *table) {
+  int slots = table->capacity + 1;
+  if (slots == 0) return;
+
+  if (table->count == 0) {
+    freeTable(table);
+    return;
   }
+
+  // shrink when less than a quarter of the load is used, down to a size
+  // that is at most half loaded so it does not grow right back.
+  if (slots > TABLE_MIN_SLOTS && table->count < slots * TABLE_MAX_LOAD / 4) {
+    int target = TABLE_MIN_SLOTS;
+    while (table->count > target * TABLE_MAX_LOAD / 2) target *= 2;
+    adjustCapacity(table, target - 1);
+    return;
+  }
+
+  if (table->tombstones > slots / 8) rehashInPlace(table);
 }
 
 void markTable(Table *table) {
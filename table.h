@@ -10,11 +10,25 @@ typedef struct
   Value value;
 } Entry;
 
+/**
+ * Table - a hash table from interned strings to values.
+ * @count: the number of keys.
+ * @tombstones: the number of deleted slots, they are reused by new keys
+ *              and dropped when the table is rehashed.
+ * @capacity: the number of slots minus one, or -1 when nothing is
+ *            allocated.
+ * @entries: the slots, a slot that is not in use has a NULL key.
+ * @control: one byte per slot, the low 7 bits of the hash of the key or
+ *           a marker for empty and deleted slots. it lives in the same
+ *           block as the entries.
+ */
 typedef struct
 {
   int count;
+  int tombstones;
   int capacity;
   Entry *entries;
+  int8_t *control;
 } Table;
 
 void initTable(Table *table);
@@ -23,8 +37,10 @@ bool tableSet(Table *table, ObjString *key, Value value);
 bool tableGet(Table *table, ObjString *key, Value *value);
 bool tableDelete(Table *table, ObjString *key);
 void tableAddAll(Table *from, Table *to);
+void tableReserve(Table *table, int count);
 ObjString *tableFindString(Table *table, const wchar_t *chars, int length, uint32_t hash);
-void tableRemoveWhite(Table *table);
+void tableCompact(Table *table);
+size_t tableSize(Table *table);
 void markTable(Table *table);
 
 #endif
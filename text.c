@@ -0,0 +1,629 @@
+#include <stdint.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#include "memory.h"
+#include "object.h"
+#include "text.h"
+#include "vm.h"
+
+// the kernels compare whole code points, wchar_t has to hold one.
+#if WCHAR_MAX > 0xFFFF && defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_WIDTH 8
+typedef __m256i Vector;
+#elif WCHAR_MAX > 0xFFFF && defined(__SSE2__)
+#include <emmintrin.h>
+#define VECTOR_WIDTH 4
+typedef __m128i Vector;
+#endif
+
+#ifdef VECTOR_WIDTH
+static inline Vector splat(wchar_t c)
+{
+#if VECTOR_WIDTH == 8
+  return _mm256_set1_epi32((int)c);
+#else
+  return _mm_set1_epi32((int)c);
+#endif
+}
+
+/**
+ * matchMask - compares VECTOR_WIDTH characters against a splatted one.
+ * Return: a bit mask with bit i set if chars[i] matched.
+ */
+static inline unsigned matchMask(const wchar_t *chars, Vector c)
+{
+#if VECTOR_WIDTH == 8
+  __m256i block = _mm256_loadu_si256((const __m256i *)chars);
+  return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, c)));
+#else
+  __m128i block = _mm_loadu_si128((const __m128i *)chars);
+  return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, c)));
+#endif
+}
+#endif
+
+/**
+ * findChar - finds the first occurrence of a character.
+ * @chars: the characters to search.
+ * @length: the number of characters.
+ * @c: the character to look for.
+ * Return: the index of the character or -1.
+ */
+static int findChar(const wchar_t *chars, int length, wchar_t c)
+{
+  int i = 0;
+#ifdef VECTOR_WIDTH
+  Vector needle = splat(c);
+  for (; i + VECTOR_WIDTH <= length; i += VECTOR_WIDTH)
+  {
+    unsigned mask = matchMask(chars + i, needle);
+    if (mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < length; i++)
+  {
+    if (chars[i] == c)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * findString - finds the first occurrence of a needle at or after from.
+ * candidates are the positions where both the first and the last character
+ * of the needle match, only those are compared in full.
+ * @chars: the characters to search.
+ * @length: the number of characters.
+ * @from: the index to start searching at.
+ * @needle: the characters to look for.
+ * @needleLength: the number of characters in the needle.
+ * Return: the index of the needle or -1.
+ */
+static int findString(const wchar_t *chars, int length, int from,
+                      const wchar_t *needle, int needleLength)
+{
+  if (needleLength == 0)
+    return from <= length ? from : -1;
+  if (needleLength > length - from)
+    return -1;
+  if (needleLength == 1)
+  {
+    int index = findChar(chars + from, length - from, needle[0]);
+    return index == -1 ? -1 : from + index;
+  }
+
+  int last = needleLength - 1;
+  int end = length - needleLength; // the last possible match.
+  int i = from;
+#ifdef VECTOR_WIDTH
+  Vector first = splat(needle[0]);
+  Vector final = splat(needle[last]);
+  for (; i + VECTOR_WIDTH - 1 <= end; i += VECTOR_WIDTH)
+  {
+    unsigned mask = matchMask(chars + i, first) & matchMask(chars + i + last, final);
+    while (mask != 0)
+    {
+      int candidate = i + __builtin_ctz(mask);
+      if (wmemcmp(chars + candidate + 1, needle + 1, needleLength - 2) == 0)
+        return candidate;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i <= end; i++)
+  {
+    if (chars[i] == needle[0] && chars[i + last] == needle[last] &&
+        wmemcmp(chars + i + 1, needle + 1, needleLength - 2) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * checkString - validates a string argument.
+ * @value: the argument.
+ * @name: the name of the native for the error message.
+ * Return: true if the value is a string.
+ */
+bool checkString(Value value, const wchar_t *name)
+{
+  if (!IS_STRING(value))
+  {
+    runtimeError(L"%ls ሀረግ ያስፈልገዋል።", name);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * checkIndex - validates a character index argument.
+ * @value: the argument.
+ * @limit: the largest allowed index.
+ * @index: where the index is written.
+ * Return: true if the value is a whole number between 0 and limit.
+ */
+static bool checkIndex(Value value, int limit, int *index)
+{
+  if (!IS_NUMBER(value))
+  {
+    runtimeError(L"ጠቋሚው ቁጥር መሆን አለበት።");
+    return false;
+  }
+
+  double number = AS_NUMBER(value);
+  // NaN fails the range test, the cast only sees numbers that fit an int.
+  if (!(number >= 0 && number <= limit) || number != (double)(int)number)
+  {
+    runtimeError(L"ጠቋሚው %g ከ 0 እስከ %d ውጪ ነው።", number, limit);
+    return false;
+  }
+
+  *index = (int)number;
+  return true;
+}
+
+/**
+ * lengthNative - the number of characters in a string, items in a list or
+ * entries in a weak map.
+ */
+static bool lengthNative(int argCount, Value *args)
+{
+  if (IS_STRING(args[0]))
+  {
+    args[-1] = NUMBER_VAL(AS_STRING(args[0])->length);
+    return true;
+  }
+  if (IS_LIST(args[0]))
+  {
+    args[-1] = NUMBER_VAL(AS_LIST(args[0])->items.count);
+    return true;
+  }
+  if (IS_WEAK_MAP(args[0]))
+  {
+    args[-1] = NUMBER_VAL(AS_WEAK_MAP(args[0])->count);
+    return true;
+  }
+
+  runtimeError(L"ርዝመት ያላቸው ሀረግ፣ ዝርዝር እና ደካማ ካርታ ብቻ ናቸው።");
+  return false;
+}
+
+/**
+ * substringNative - returns the characters from start up to, but not
+ * including, end. the result shares the characters of its argument.
+ */
+static bool substringNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ቁራጭ"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  int start, end;
+  if (!checkIndex(args[1], string->length, &start) ||
+      !checkIndex(args[2], string->length, &end))
+    return false;
+
+  if (end < start)
+  {
+    runtimeError(L"መጨረሻው ከመጀመሪያው ማነስ አይችልም።");
+    return false;
+  }
+
+  args[-1] = OBJ_VAL(sliceString(string, start, end - start));
+  return true;
+}
+
+/**
+ * findNative - the index of the first occurrence of a string, or -1.
+ */
+static bool findNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ፈልግ") || !checkString(args[1], L"ፈልግ"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *needle = AS_STRING(args[1]);
+  int index = findString(string->chars, string->length, 0,
+                         needle->chars, needle->length);
+  args[-1] = NUMBER_VAL(index);
+  return true;
+}
+
+/**
+ * containsNative - whether a string occurs in another string.
+ */
+static bool containsNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ይዟል") || !checkString(args[1], L"ይዟል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *needle = AS_STRING(args[1]);
+  int index = findString(string->chars, string->length, 0,
+                         needle->chars, needle->length);
+  args[-1] = BOOL_VAL(index != -1);
+  return true;
+}
+
+static bool startsWithNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ይጀምራል") || !checkString(args[1], L"ይጀምራል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *prefix = AS_STRING(args[1]);
+  args[-1] = BOOL_VAL(prefix->length <= string->length &&
+                      wmemcmp(string->chars, prefix->chars, prefix->length) == 0);
+  return true;
+}
+
+static bool endsWithNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ያበቃል") || !checkString(args[1], L"ያበቃል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *suffix = AS_STRING(args[1]);
+  args[-1] = BOOL_VAL(suffix->length <= string->length &&
+                      wmemcmp(string->chars + string->length - suffix->length,
+                              suffix->chars, suffix->length) == 0);
+  return true;
+}
+
+/**
+ * appendSlice - appends a slice of a string to a list.
+ * the list has to be reachable, the slice is allocated before it is added.
+ */
+static void appendSlice(ObjList *list, ObjString *string, int start, int length)
+{
+  Value slice = OBJ_VAL(sliceString(string, start, length));
+  push(slice);
+  writeValueArray(&list->items, slice);
+  writeBarrier((Obj *)list, slice);
+  pop();
+}
+
+/**
+ * splitNative - splits a string on a separator into a list of slices.
+ * an empty separator splits the string into its characters.
+ */
+static bool splitNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ክፈል") || !checkString(args[1], L"ክፈል"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *separator = AS_STRING(args[1]);
+  ObjList *list = newList();
+  push(OBJ_VAL(list));
+
+  if (separator->length == 0)
+  {
+    for (int i = 0; i < string->length; i++)
+      appendSlice(list, string, i, 1);
+  }
+  else
+  {
+    int start = 0;
+    for (;;)
+    {
+      int index = findString(string->chars, string->length, start,
+                             separator->chars, separator->length);
+      if (index == -1)
+        break;
+      appendSlice(list, string, start, index - start);
+      start = index + separator->length;
+    }
+    appendSlice(list, string, start, string->length - start);
+  }
+
+  args[-1] = pop();
+  return true;
+}
+
+/**
+ * linesNative - splits a string into its lines, a final newline does not
+ * start another line and "\r\n" endings are removed.
+ */
+static bool linesNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"መስመሮች"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjList *list = newList();
+  push(OBJ_VAL(list));
+
+  int start = 0;
+  while (start < string->length)
+  {
+    int index = findChar(string->chars + start, string->length - start, L'\n');
+    int end = index == -1 ? string->length : start + index;
+    int lineEnd = end > start && string->chars[end - 1] == L'\r' ? end - 1 : end;
+    appendSlice(list, string, start, lineEnd - start);
+    start = end + 1;
+  }
+
+  args[-1] = pop();
+  return true;
+}
+
+/**
+ * joinNative - joins a list of strings with a separator in between.
+ */
+static bool joinNative(int argCount, Value *args)
+{
+  if (!IS_LIST(args[0]))
+  {
+    runtimeError(L"አገጣጥም ዝርዝር ያስፈልገዋል።");
+    return false;
+  }
+  if (!checkString(args[1], L"አገጣጥም"))
+    return false;
+
+  ValueArray *items = &AS_LIST(args[0])->items;
+  ObjString *separator = AS_STRING(args[1]);
+
+  size_t length = 0;
+  for (int i = 0; i < items->count; i++)
+  {
+    if (!IS_STRING(items->values[i]))
+    {
+      runtimeError(L"የዝርዝሩ አባል %d ሀረግ አይደለም።", i);
+      return false;
+    }
+    length += AS_STRING(items->values[i])->length;
+  }
+  if (items->count > 0)
+    length += (size_t)separator->length * (items->count - 1);
+  if (length > INT32_MAX)
+  {
+    runtimeError(L"የሚገጣጠመው ሀረግ በጣም ትልቅ ነው።");
+    return false;
+  }
+
+  wchar_t *chars = ALLOCATE(wchar_t, length + 1);
+  wchar_t *out = chars;
+  for (int i = 0; i < items->count; i++)
+  {
+    if (i > 0)
+    {
+      wmemcpy(out, separator->chars, separator->length);
+      out += separator->length;
+    }
+    ObjString *item = AS_STRING(items->values[i]);
+    wmemcpy(out, item->chars, item->length);
+    out += item->length;
+  }
+  *out = L'\0';
+
+  args[-1] = OBJ_VAL(takeString(chars, (int)length));
+  return true;
+}
+
+/**
+ * replaceNative - replaces every occurrence of a string with another one.
+ * the matches are counted first so the result is allocated once.
+ */
+static bool replaceNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ተካ") || !checkString(args[1], L"ተካ") ||
+      !checkString(args[2], L"ተካ"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  ObjString *from = AS_STRING(args[1]);
+  ObjString *to = AS_STRING(args[2]);
+  if (from->length == 0)
+  {
+    args[-1] = args[0];
+    return true;
+  }
+
+  size_t matches = 0;
+  for (int i = findString(string->chars, string->length, 0, from->chars, from->length);
+       i != -1;
+       i = findString(string->chars, string->length, i + from->length, from->chars, from->length))
+    matches++;
+
+  if (matches == 0)
+  {
+    args[-1] = args[0];
+    return true;
+  }
+
+  long length = string->length + (long)matches * (to->length - from->length);
+  if (length > INT32_MAX)
+  {
+    runtimeError(L"የተተካው ሀረግ በጣም ትልቅ ነው።");
+    return false;
+  }
+
+  wchar_t *chars = ALLOCATE(wchar_t, length + 1);
+  wchar_t *out = chars;
+  int start = 0;
+  for (;;)
+  {
+    int index = findString(string->chars, string->length, start,
+                           from->chars, from->length);
+    int end = index == -1 ? string->length : index;
+    wmemcpy(out, string->chars + start, end - start);
+    out += end - start;
+    if (index == -1)
+      break;
+    wmemcpy(out, to->chars, to->length);
+    out += to->length;
+    start = index + from->length;
+  }
+  *out = L'\0';
+
+  args[-1] = OBJ_VAL(takeString(chars, (int)length));
+  return true;
+}
+
+/**
+ * trimNative - removes leading and trailing white space, including the
+ * ethiopic word space.
+ */
+static bool trimNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ከርክም"))
+    return false;
+
+  ObjString *string = AS_STRING(args[0]);
+  int start = 0;
+  int end = string->length;
+  while (start < end && (iswspace(string->chars[start]) || string->chars[start] == L'፡'))
+    start++;
+  while (end > start && (iswspace(string->chars[end - 1]) || string->chars[end - 1] == L'፡'))
+    end--;
+
+  args[-1] = OBJ_VAL(sliceString(string, start, end - start));
+  return true;
+}
+
+/**
+ * convertCase - maps every character of a string, the string is returned
+ * as is when nothing changes. ethiopic has no case, so the ASCII and
+ * ethiopic ranges skip the locale tables.
+ */
+static ObjString *convertCase(ObjString *string, bool upper)
+{
+  int first = 0;
+  for (; first < string->length; first++)
+  {
+    wchar_t c = string->chars[first];
+    if (c >= 0x1200 && c <= 0x137F)
+      continue;
+    if ((upper ? towupper(c) : towlower(c)) != (wint_t)c)
+      break;
+  }
+  if (first == string->length)
+    return string;
+
+  wchar_t *chars = ALLOCATE(wchar_t, string->length + 1);
+  wmemcpy(chars, string->chars, first);
+  for (int i = first; i < string->length; i++)
+  {
+    wchar_t c = string->chars[i];
+    if (c < 0x80)
+    {
+      if (upper && c >= L'a' && c <= L'z')
+        c -= L'a' - L'A';
+      else if (!upper && c >= L'A' && c <= L'Z')
+        c += L'a' - L'A';
+    }
+    else if (c < 0x1200 || c > 0x137F)
+    {
+      c = (wchar_t)(upper ? towupper(c) : towlower(c));
+    }
+    chars[i] = c;
+  }
+  chars[string->length] = L'\0';
+
+  return takeString(chars, string->length);
+}
+
+static bool lowerNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ወደ_ትንሽ"))
+    return false;
+
+  args[-1] = OBJ_VAL(convertCase(AS_STRING(args[0]), false));
+  return true;
+}
+
+static bool upperNative(int argCount, Value *args)
+{
+  if (!checkString(args[0], L"ወደ_ትልቅ"))
+    return false;
+
+  args[-1] = OBJ_VAL(convertCase(AS_STRING(args[0]), true));
+  return true;
+}
+
+/**
+ * listNative - makes a list out of its arguments.
+ */
+static bool listNative(int argCount, Value *args)
+{
+  ObjList *list = newList();
+  push(OBJ_VAL(list));
+  for (int i = 0; i < argCount; i++)
+  {
+    writeValueArray(&list->items, args[i]);
+    writeBarrier((Obj *)list, args[i]);
+  }
+  args[-1] = pop();
+  return true;
+}
+
+/**
+ * itemNative - the item of a list at an index.
+ */
+static bool itemNative(int argCount, Value *args)
+{
+  if (!IS_LIST(args[0]))
+  {
+    runtimeError(L"አባል ዝርዝር ያስፈልገዋል።");
+    return false;
+  }
+
+  ValueArray *items = &AS_LIST(args[0])->items;
+  if (items->count == 0)
+  {
+    runtimeError(L"ዝርዝሩ ባዶ ነው፣ አባል የለውም።");
+    return false;
+  }
+  int index;
+  if (!checkIndex(args[1], items->count - 1, &index))
+    return false;
+
+  args[-1] = items->values[index];
+  return true;
+}
+
+/**
+ * appendNative - adds a value at the end of a list.
+ */
+static bool appendNative(int argCount, Value *args)
+{
+  if (!IS_LIST(args[0]))
+  {
+    runtimeError(L"ጨምር ዝርዝር ያስፈልገዋል።");
+    return false;
+  }
+
+  writeValueArray(&AS_LIST(args[0])->items, args[1]);
+  writeBarrier(AS_OBJ(args[0]), args[1]);
+  args[-1] = args[0];
+  return true;
+}
+
+/**
+ * initTextNatives - defines the string and list natives.
+ * Return: nothing.
+ */
+void initTextNatives()
+{
+  defineNative(L"ርዝመት", 1, lengthNative);
+  defineNative(L"ቁራጭ", 3, substringNative);
+  defineNative(L"ፈልግ", 2, findNative);
+  defineNative(L"ይዟል", 2, containsNative);
+  defineNative(L"ይጀምራል", 2, startsWithNative);
+  defineNative(L"ያበቃል", 2, endsWithNative);
+  defineNative(L"ክፈል", 2, splitNative);
+  defineNative(L"መስመሮች", 1, linesNative);
+  defineNative(L"አገጣጥም", 2, joinNative);
+  defineNative(L"ተካ", 3, replaceNative);
+  defineNative(L"ከርክም", 1, trimNative);
+  defineNative(L"ወደ_ትንሽ", 1, lowerNative);
+  defineNative(L"ወደ_ትልቅ", 1, upperNative);
+
+  defineNative(L"ዝርዝር", -1, listNative);
+  defineNative(L"አባል", 2, itemNative);
+  defineNative(L"ጨምር", 2, appendNative);
+}
@@ -0,0 +1,10 @@
+#ifndef AHADU_TEXT_H
+#define AHADU_TEXT_H
+
+#include "common.h"
+#include "value.h"
+
+bool checkString(Value value, const wchar_t *name);
+void initTextNatives();
+
+#endif // !AHADU_TEXT_H
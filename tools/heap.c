@@ -0,0 +1,461 @@
+/*
+ * heap - reads a heap dump written by ክምር_ጻፍ() or SIGUSR1 and prints
+ * what keeps the memory alive: the objects that retain the most bytes and
+ * the dominator tree. an object dominates another when every path from
+ * the roots to the other goes through it, it retains what it dominates.
+ *
+ *   gcc -O2 tools/heap.c -o heap
+ *   ./heap [-n COUNT] [-d DEPTH] FILE
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_NODE (-1)
+
+/**
+ * Node - an object of the dump, node 0 stands for the roots.
+ * @address: the address the object had.
+ * @type: the type of the object.
+ * @label: what the object is called.
+ * @root: the first root that holds the object, or NULL.
+ * @size: the size of the object with the memory it owns.
+ * @retained: the size of the objects it dominates, its own included.
+ * @firstEdge: where its references start in the edge array.
+ * @edgeCount: the number of its references.
+ * @order: its place in the reverse postorder, NO_NODE when unreachable.
+ * @dominator: its immediate dominator.
+ */
+typedef struct
+{
+  uint64_t address;
+  char *type;
+  char *label;
+  char *root;
+  size_t size;
+  size_t retained;
+  int firstEdge;
+  int edgeCount;
+  int order;
+  int dominator;
+} Node;
+
+static Node *nodes = NULL;
+static int nodeCount = 0;
+static int nodeCapacity = 0;
+
+// the references by address, resolved to nodes once every object is read.
+static uint64_t *targets = NULL;
+static int *edges = NULL;
+static int edgeCount = 0;
+static int edgeCapacity = 0;
+
+// the nodes by address, an open addressing table.
+static int *addressIndex = NULL;
+static int indexCapacity = 0;
+
+static void *growOrExit(void *pointer, size_t size)
+{
+  void *result = realloc(pointer, size);
+  if (result == NULL)
+  {
+    fprintf(stderr, "ማህደረ ትውስታ አልቋል።\n");
+    exit(1);
+  }
+  return result;
+}
+
+static char *copyText(const char *text)
+{
+  size_t length = strlen(text);
+  char *copy = (char *)growOrExit(NULL, length + 1);
+  memcpy(copy, text, length + 1);
+  return copy;
+}
+
+static uint32_t hashAddress(uint64_t address)
+{
+  address ^= address >> 33;
+  address *= 0xff51afd7ed558ccdull;
+  address ^= address >> 33;
+  return (uint32_t)address;
+}
+
+/**
+ * findNode - finds the node of an address.
+ * @address: the address.
+ * Return: the node, or NO_NODE.
+ */
+static int findNode(uint64_t address)
+{
+  uint32_t mask = indexCapacity - 1;
+  for (uint32_t slot = hashAddress(address) & mask; addressIndex[slot] != NO_NODE;
+       slot = (slot + 1) & mask)
+  {
+    if (nodes[addressIndex[slot]].address == address)
+      return addressIndex[slot];
+  }
+  return NO_NODE;
+}
+
+static void indexNode(int node)
+{
+  uint32_t mask = indexCapacity - 1;
+  uint32_t slot = hashAddress(nodes[node].address) & mask;
+  while (addressIndex[slot] != NO_NODE)
+    slot = (slot + 1) & mask;
+  addressIndex[slot] = node;
+}
+
+static int addNode(uint64_t address)
+{
+  if (nodeCount + 1 > nodeCapacity)
+  {
+    nodeCapacity = nodeCapacity < 1024 ? 1024 : nodeCapacity * 2;
+    nodes = (Node *)growOrExit(nodes, sizeof(Node) * nodeCapacity);
+  }
+  Node *node = &nodes[nodeCount];
+  memset(node, 0, sizeof(Node));
+  node->address = address;
+  node->type = "";
+  node->label = "";
+  node->root = NULL;
+  node->firstEdge = edgeCount;
+  return nodeCount++;
+}
+
+static void addEdge(uint64_t target)
+{
+  if (edgeCount + 1 > edgeCapacity)
+  {
+    edgeCapacity = edgeCapacity < 1024 ? 1024 : edgeCapacity * 2;
+    targets = (uint64_t *)growOrExit(targets, sizeof(uint64_t) * edgeCapacity);
+  }
+  targets[edgeCount++] = target;
+}
+
+/**
+ * readDump - reads the records of a dump. the roots become the edges of
+ * node 0, the edges of an object follow the ones of the object before it.
+ * @file: the dump.
+ * Return: nothing, the program exits if it is not a dump.
+ */
+static void readDump(FILE *file)
+{
+  // a record is one line however many references it has.
+  char *line = NULL;
+  size_t lineCapacity = 0;
+  if (getline(&line, &lineCapacity, file) < 0 || strcmp(line, "ahadu-heap 1\n") != 0)
+  {
+    fprintf(stderr, "ፋይሉ የክምር ቅጂ አይደለም።\n");
+    exit(65);
+  }
+
+  int roots = addNode(0);
+  // the roots come first, the labels are kept until the objects are read.
+  char **rootLabels = NULL;
+  int rootCount = 0;
+
+  while (getline(&line, &lineCapacity, file) >= 0)
+  {
+    line[strcspn(line, "\n")] = '\0';
+    char *rest;
+    if (strncmp(line, "root ", 5) == 0)
+    {
+      uint64_t address = strtoull(line + 5, &rest, 16);
+      addEdge(address);
+      rootLabels = (char **)growOrExit(rootLabels, sizeof(char *) * (rootCount + 1));
+      rootLabels[rootCount++] = copyText(rest + 1);
+      nodes[roots].edgeCount++;
+    }
+    else if (strncmp(line, "object ", 7) == 0)
+    {
+      int node = addNode(strtoull(line + 7, &rest, 16));
+      char *type = strtok_r(rest, " ", &rest);
+      char *size = strtok_r(NULL, " ", &rest);
+      char *references = strtok_r(NULL, " ", &rest);
+      if (type == NULL || size == NULL || references == NULL)
+      {
+        fprintf(stderr, "የተበላሸ መስመር: %s\n", line);
+        exit(65);
+      }
+      nodes[node].type = copyText(type);
+      nodes[node].size = strtoull(size, NULL, 10);
+      nodes[node].label = copyText(rest);
+      for (char *next = references; *references != '-' && *next != '\0';)
+      {
+        addEdge(strtoull(next, &next, 16));
+        nodes[node].edgeCount++;
+        if (*next == ',')
+          next++;
+      }
+    }
+  }
+  free(line);
+
+  indexCapacity = 1;
+  while (indexCapacity < nodeCount * 2)
+    indexCapacity *= 2;
+  addressIndex = (int *)growOrExit(NULL, sizeof(int) * indexCapacity);
+  for (int i = 0; i < indexCapacity; i++)
+    addressIndex[i] = NO_NODE;
+  for (int i = 1; i < nodeCount; i++)
+    indexNode(i);
+
+  // an edge to an address that is not in the dump is dropped.
+  edges = (int *)growOrExit(NULL, sizeof(int) * (edgeCount + 1));
+  for (int i = 0; i < edgeCount; i++)
+    edges[i] = findNode(targets[i]);
+  for (int i = 0; i < rootCount; i++)
+  {
+    int node = edges[i];
+    if (node != NO_NODE && nodes[node].root == NULL)
+      nodes[node].root = rootLabels[i];
+    else
+      free(rootLabels[i]);
+  }
+  free(rootLabels);
+}
+
+/**
+ * orderNodes - numbers the nodes reachable from the roots in reverse
+ * postorder, with a stack instead of recursion.
+ * @order: filled with the nodes in reverse postorder.
+ * Return: the number of reachable nodes.
+ */
+static int orderNodes(int *order)
+{
+  for (int i = 0; i < nodeCount; i++)
+    nodes[i].order = NO_NODE;
+
+  int *stack = (int *)growOrExit(NULL, sizeof(int) * nodeCount);
+  int *next = (int *)growOrExit(NULL, sizeof(int) * nodeCount);
+  int depth = 0;
+  int finished = 0;
+  stack[depth++] = 0;
+  next[0] = 0;
+  nodes[0].order = 0;
+
+  while (depth > 0)
+  {
+    int node = stack[depth - 1];
+    if (next[node] < nodes[node].edgeCount)
+    {
+      int child = edges[nodes[node].firstEdge + next[node]++];
+      if (child != NO_NODE && nodes[child].order == NO_NODE)
+      {
+        nodes[child].order = 0;
+        next[child] = 0;
+        stack[depth++] = child;
+      }
+      continue;
+    }
+    depth--;
+    order[finished++] = node;
+  }
+
+  // reverse the postorder.
+  for (int i = 0; i < finished / 2; i++)
+  {
+    int swap = order[i];
+    order[i] = order[finished - 1 - i];
+    order[finished - 1 - i] = swap;
+  }
+  for (int i = 0; i < finished; i++)
+    nodes[order[i]].order = i;
+  free(stack);
+  free(next);
+  return finished;
+}
+
+static int intersect(int a, int b)
+{
+  while (a != b)
+  {
+    while (nodes[a].order > nodes[b].order)
+      a = nodes[a].dominator;
+    while (nodes[b].order > nodes[a].order)
+      b = nodes[b].dominator;
+  }
+  return a;
+}
+
+/**
+ * findDominators - the iterative algorithm of Cooper, Harvey and Kennedy.
+ * the immediate dominator of a node is the nearest common dominator of
+ * its predecessors, repeated until nothing changes.
+ * @order: the reachable nodes in reverse postorder.
+ * @count: the number of reachable nodes.
+ * Return: nothing.
+ */
+static void findDominators(int *order, int count)
+{
+  // the predecessors of each node, from the reachable nodes only.
+  int *predecessorCount = (int *)calloc((size_t)nodeCount + 1, sizeof(int));
+  for (int i = 0; i < count; i++)
+  {
+    Node *node = &nodes[order[i]];
+    for (int e = 0; e < node->edgeCount; e++)
+    {
+      int child = edges[node->firstEdge + e];
+      if (child != NO_NODE)
+        predecessorCount[child + 1]++;
+    }
+  }
+  for (int i = 0; i < nodeCount; i++)
+    predecessorCount[i + 1] += predecessorCount[i];
+  int *predecessors = (int *)growOrExit(NULL, sizeof(int) * (predecessorCount[nodeCount] + 1));
+  int *filled = (int *)calloc((size_t)nodeCount, sizeof(int));
+  for (int i = 0; i < count; i++)
+  {
+    Node *node = &nodes[order[i]];
+    for (int e = 0; e < node->edgeCount; e++)
+    {
+      int child = edges[node->firstEdge + e];
+      if (child != NO_NODE)
+        predecessors[predecessorCount[child] + filled[child]++] = order[i];
+    }
+  }
+
+  for (int i = 0; i < nodeCount; i++)
+    nodes[i].dominator = NO_NODE;
+  nodes[0].dominator = 0;
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (int i = 1; i < count; i++)
+    {
+      int node = order[i];
+      int dominator = NO_NODE;
+      for (int p = predecessorCount[node]; p < predecessorCount[node + 1]; p++)
+      {
+        int predecessor = predecessors[p];
+        if (nodes[predecessor].dominator == NO_NODE)
+          continue;
+        dominator = dominator == NO_NODE ? predecessor : intersect(predecessor, dominator);
+      }
+      if (nodes[node].dominator != dominator)
+      {
+        nodes[node].dominator = dominator;
+        changed = true;
+      }
+    }
+  }
+
+  // a node is done before its dominator in postorder.
+  for (int i = count - 1; i >= 0; i--)
+  {
+    Node *node = &nodes[order[i]];
+    node->retained += node->size;
+    if (i > 0)
+      nodes[node->dominator].retained += node->retained;
+  }
+  free(predecessorCount);
+  free(predecessors);
+  free(filled);
+}
+
+static int byRetained(const void *a, const void *b)
+{
+  size_t left = nodes[*(const int *)a].retained;
+  size_t right = nodes[*(const int *)b].retained;
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+static void printNode(int node, int depth)
+{
+  Node *n = &nodes[node];
+  printf("%*s%zu %zu %s %s", depth * 2, "", n->retained, n->size, n->type, n->label);
+  if (n->root != NULL)
+    printf(" (%s)", n->root);
+  printf("\n");
+}
+
+/**
+ * printTree - prints the dominator tree under a node, the children that
+ * retain the most first. a node that retains less than a thousandth of
+ * the heap is left out.
+ * @node: the node.
+ * @children: the children of each node, sorted.
+ * @firstChild: where the children of each node start.
+ * @depth: how deep the node is.
+ * @maxDepth: the deepest level printed.
+ * Return: nothing.
+ */
+static void printTree(int node, int *children, int *firstChild, int depth, int maxDepth)
+{
+  if (depth > 0)
+    printNode(node, depth - 1);
+  if (depth == maxDepth)
+    return;
+  for (int c = firstChild[node]; c < firstChild[node + 1]; c++)
+  {
+    if (nodes[children[c]].retained * 1000 < nodes[0].retained)
+      break;
+    printTree(children[c], children, firstChild, depth + 1, maxDepth);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int top = 20;
+  int maxDepth = 4;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      top = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+      maxDepth = atoi(argv[++i]);
+    else
+      path = argv[i];
+  }
+  if (path == NULL)
+  {
+    fprintf(stderr, "አጠቃቀም: heap [-n COUNT] [-d DEPTH] FILE\n");
+    return 64;
+  }
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "ፋይሉን መክፈት አልተቻለም \"%s\".\n", path);
+    return 74;
+  }
+  readDump(file);
+  fclose(file);
+
+  int *order = (int *)growOrExit(NULL, sizeof(int) * nodeCount);
+  int count = orderNodes(order);
+  findDominators(order, count);
+  printf("%d objects, %zu bytes reachable from the roots\n", count - 1, nodes[0].retained);
+
+  int *sorted = (int *)growOrExit(NULL, sizeof(int) * count);
+  memcpy(sorted, order, sizeof(int) * count);
+  qsort(sorted + 1, count - 1, sizeof(int), byRetained);
+  printf("\nretained shallow type label (root)\n");
+  for (int i = 1; i < count && i <= top; i++)
+    printNode(sorted[i], 0);
+
+  // the children of each node in the dominator tree, by retained size.
+  int *firstChild = (int *)calloc((size_t)nodeCount + 1, sizeof(int));
+  int *children = (int *)growOrExit(NULL, sizeof(int) * count);
+  for (int i = 1; i < count; i++)
+    firstChild[nodes[sorted[i]].dominator + 1]++;
+  for (int i = 0; i < nodeCount; i++)
+    firstChild[i + 1] += firstChild[i];
+  int *filled = (int *)calloc((size_t)nodeCount, sizeof(int));
+  for (int i = 1; i < count; i++)
+  {
+    int dominator = nodes[sorted[i]].dominator;
+    children[firstChild[dominator] + filled[dominator]++] = sorted[i];
+  }
+  printf("\ndominator tree\n");
+  printTree(0, children, firstChild, 0, maxDepth);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * tables - times tableGet on its own, in nanoseconds per lookup, for a
+ * few table sizes, once with keys that are in the table and once with
+ * keys that are not. it only uses the Table API, so it builds against
+ * the sources of any revision and benchmarks/tables.sh compares two.
+ *
+ *   gcc -O2 -I. tools/tables.c $(ls *.c | grep -v '^main.c$') -o tables -lm -lpthread
+ *   ./tables
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+#define MAX_KEYS 6100
+#define LOOKUPS 20000000
+
+static ObjString *hits[MAX_KEYS];
+static ObjString *misses[MAX_KEYS];
+
+/**
+ * makeKey - makes a key, it is kept alive as a global.
+ * @prefix: the text before the number.
+ * @number: the number.
+ * Return: the key.
+ */
+static ObjString *makeKey(const wchar_t *prefix, int number)
+{
+  wchar_t text[32];
+  int length = swprintf(text, 32, L"%ls%d", prefix, number);
+  ObjString *key = copyString(text, length);
+  tableSet(&vm.globals, key, NIL_VAL);
+  return key;
+}
+
+/**
+ * now - the monotonic clock.
+ * Return: the time in nanoseconds.
+ */
+static double now()
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+/**
+ * timeLookups - looks the keys up over and over.
+ * @table: the table.
+ * @keys: the keys.
+ * @count: the number of keys.
+ * Return: the nanoseconds per lookup.
+ */
+static double timeLookups(Table *table, ObjString **keys, int count)
+{
+  Value value;
+  int found = 0;
+  double start = now();
+  for (int i = 0, k = 0; i < LOOKUPS; i++)
+  {
+    found += tableGet(table, keys[k], &value);
+    if (++k == count)
+      k = 0;
+  }
+  double elapsed = now() - start;
+  // keeps the loop from being optimised away.
+  if (found < 0)
+    printf("%d\n", found);
+  return elapsed / LOOKUPS;
+}
+
+int main()
+{
+  static const int sizes[] = {6, 48, MAX_KEYS};
+  initVM();
+
+  for (int i = 0; i < MAX_KEYS; i++)
+  {
+    hits[i] = makeKey(L"ቁልፍ", i);
+    misses[i] = makeKey(L"የለም", i);
+  }
+
+  for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+  {
+    Table table;
+    initTable(&table);
+    for (int i = 0; i < sizes[s]; i++)
+      tableSet(&table, hits[i], NUMBER_VAL(i));
+
+    printf("%d keys: hit %.1f ns, miss %.1f ns\n", sizes[s],
+           timeLookups(&table, hits, sizes[s]),
+           timeLookups(&table, misses, sizes[s]));
+    freeTable(&table);
+  }
+
+  freeVM();
+  return 0;
+}
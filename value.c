@@ -1,8 +1,12 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 
 #include "object.h"
+#include "io.h"
 #include "memory.h"
+#include "number.h"
 #include "value.h"
 
 /**
@@ -16,6 +20,32 @@ void initValueArray(ValueArray *array) {
   array->count = 0;
 }
 
+/**
+ * growValueArray - makes room for more values. the background marker may
+ * be reading the old values, so with it they are copied to a new block
+ * that is put in place under the lock and freed after.
+ * @array: a pointer to a value array.
+ * Return: Nothing.
+ */
+static void growValueArray(ValueArray *array) {
+  int oldCapacity = array->capacity;
+  int capacity = GROW_CAPACITY(oldCapacity);
+  if (!vm.gcConcurrent) {
+    array->values = GROW_ARRAY(Value, array->values, oldCapacity, capacity);
+    array->capacity = capacity;
+    return;
+  }
+
+  Value *values = ALLOCATE(Value, capacity);
+  Value *old = array->values;
+  bool locked = lockHeap();
+  if (array->count > 0) memcpy(values, old, sizeof(Value) * array->count);
+  array->values = values;
+  array->capacity = capacity;
+  unlockHeap(locked);
+  FREE_ARRAY(Value, old, oldCapacity);
+}
+
 /**
  * writeValueArray - writes a value in to a value array. it also handles dynamicaly allocating the array if needed.
  * @array: a pointer to a value array.
@@ -23,14 +53,12 @@ void initValueArray(ValueArray *array) {
  * Return: Nothing.
  */
 void writeValueArray(ValueArray *array, Value value) {
-  if (array->capacity  < array->count + 1) {
-    int oldCapacity = array->capacity;
-    array->capacity = GROW_CAPACITY(oldCapacity);
-    array->values = GROW_ARRAY(Value, array->values, oldCapacity, array->capacity);
-  }
+  if (array->capacity  < array->count + 1) growValueArray(array);
 
+  bool locked = lockHeap();
   array->values[array->count] = value;
   array->count++;
+  unlockHeap(locked);
 }
 
 /**
@@ -43,30 +71,132 @@ void freeValueArray(ValueArray *array) {
   initValueArray(array);
 }
 
+/**
+ * initTextBuffer - initializes a text buffer.
+ * @text: the text buffer.
+ * Return: Nothing.
+ */
+void initTextBuffer(TextBuffer *text) {
+  text->capacity = 0;
+  text->length = 0;
+  text->chars = NULL;
+}
 
-void printValue(Value value) {
+/**
+ * freeTextBuffer - frees a text buffer.
+ * @text: the text buffer.
+ * Return: Nothing.
+ */
+void freeTextBuffer(TextBuffer *text) {
+  free(text->chars);
+  initTextBuffer(text);
+}
+
+/**
+ * reserveText - makes room for more characters. the buffer is scratch
+ * space that never holds objects, so it is not counted by the collector.
+ * @text: the text buffer.
+ * @extra: the number of characters to make room for.
+ * Return: Nothing.
+ */
+static void reserveText(TextBuffer *text, int extra) {
+  if (text->length + extra <= text->capacity) return;
+
+  int capacity = text->capacity < 64 ? 64 : text->capacity;
+  while (capacity < text->length + extra) capacity *= 2;
+  text->chars = realloc(text->chars, capacity * sizeof(wchar_t));
+  if (text->chars == NULL) exit(1);
+  text->capacity = capacity;
+}
+
+/**
+ * appendChars - appends characters to a text buffer.
+ * @text: the text buffer.
+ * @chars: the characters.
+ * @length: the number of characters.
+ * Return: Nothing.
+ */
+void appendChars(TextBuffer *text, const wchar_t *chars, int length) {
+  reserveText(text, length);
+  wmemcpy(text->chars + text->length, chars, length);
+  text->length += length;
+}
+
+/**
+ * appendAscii - appends a null terminated ascii string to a text buffer.
+ * @text: the text buffer.
+ * @chars: the string.
+ * Return: Nothing.
+ */
+void appendAscii(TextBuffer *text, const char *chars) {
+  int length = (int)strlen(chars);
+  reserveText(text, length);
+  for (int i = 0; i < length; i++) {
+    text->chars[text->length++] = (wchar_t)chars[i];
+  }
+}
+
+/**
+ * appendValue - appends the text አውጣ prints for a value.
+ * @text: the text buffer.
+ * @value: the value.
+ * Return: Nothing.
+ */
+void appendValue(TextBuffer *text, Value value) {
 #ifdef NAN_BOXING
   if (IS_BOOL(value)) {
-    printf(AS_BOOL(value) ? "true" : "false");
+    appendAscii(text, AS_BOOL(value) ? "true" : "false");
   } else if (IS_NIL(value)) {
-    printf("nil");
+    appendAscii(text, "nil");
   } else if (IS_NUMBER(value)) {
-    printf("%g", AS_NUMBER(value));
+    char buffer[NUMBER_BUFFER_SIZE];
+    formatNumber(AS_NUMBER(value), buffer);
+    appendAscii(text, buffer);
   } else if (IS_OBJ(value)) {
-    printObject(value);
+    appendObject(text, value);
   }
 #else
   switch (value.type) {
     case VAL_BOOL:
-      printf(AS_BOOL(value) ? "true" : "false");
+      appendAscii(text, AS_BOOL(value) ? "true" : "false");
+      break;
+    case VAL_NIL: appendAscii(text, "nil"); break;
+    case VAL_NUMBER: {
+      char buffer[NUMBER_BUFFER_SIZE];
+      formatNumber(AS_NUMBER(value), buffer);
+      appendAscii(text, buffer);
       break;
-    case VAL_NIL: printf("nil"); break;
-    case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
-    case VAL_OBJ: printObject(value);
+    }
+    case VAL_OBJ: appendObject(text, value);
   }
 #endif
 }
 
+/**
+ * printValue - prints a value to the output. strings and numbers are
+ * written straight to the output buffer.
+ * @value: the value.
+ * Return: Nothing.
+ */
+void printValue(Value value) {
+  if (IS_STRING(value)) {
+    writeOutputChars(AS_STRING(value)->chars, AS_STRING(value)->length);
+    return;
+  }
+  if (IS_NUMBER(value)) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    formatNumber(AS_NUMBER(value), buffer);
+    writeOutputText(buffer);
+    return;
+  }
+
+  TextBuffer text;
+  initTextBuffer(&text);
+  appendValue(&text, value);
+  writeOutputChars(text.chars, text.length);
+  freeTextBuffer(&text);
+}
+
 bool valuesEqual(Value a, Value b) {
 #ifdef NAN_BOXING
   if (IS_NUMBER(a) && IS_NUMBER(b)) {
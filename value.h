@@ -2,6 +2,7 @@
 #define AHADU_VALUE_H
 
 #include <string.h>
+#include <wchar.h>
 
 #include "common.h"
 
@@ -102,10 +103,29 @@ typedef struct
   Value *values;
 } ValueArray;
 
+/**
+ * TextBuffer - a growable buffer of characters that values are formatted
+ * into.
+ * @capacity: the number of characters that fit.
+ * @length: the number of characters used.
+ * @chars: the characters, not null terminated.
+ */
+typedef struct
+{
+  int capacity;
+  int length;
+  wchar_t *chars;
+} TextBuffer;
+
 bool valuesEqual(Value a, Value b);
 void initValueArray(ValueArray *array);
 void writeValueArray(ValueArray *array, Value value);
 void freeValueArray(ValueArray *array);
+void initTextBuffer(TextBuffer *text);
+void freeTextBuffer(TextBuffer *text);
+void appendChars(TextBuffer *text, const wchar_t *chars, int length);
+void appendAscii(TextBuffer *text, const char *chars);
+void appendValue(TextBuffer *text, Value value);
 void printValue(Value value);
 
 #endif
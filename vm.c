@@ -6,15 +6,39 @@
 #include "common.h"
 #include "compiler.h"
 #include "debug.h"
+#include "dump.h"
+#include "ethiopic.h"
+#include "io.h"
 #include "object.h"
 #include "memory.h"
+#include "number.h"
+#include "profile.h"
+#include "stats.h"
+#include "text.h"
 #include "vm.h"
+#include "weak.h"
 
 VM vm;
 
-static Value clockNative(int argCount, Value *args)
+static bool clockNative(int argCount, Value *args)
 {
-  return NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+  args[-1] = NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+  return true;
+}
+
+/**
+ * collectNative - collects the garbage in one pause, the heap is then
+ * compacted at the next safepoint.
+ * @argCount: the number of arguments.
+ * @args: the arguments.
+ * Return: true.
+ */
+static bool collectNative(int argCount, Value *args)
+{
+  collectGarbage();
+  vm.compactionRequested = true;
+  args[-1] = NIL_VAL;
+  return true;
 }
 
 /**
@@ -26,6 +50,7 @@ static void resetStack()
   vm.stackTop = vm.stack;
   vm.frameCount = 0;
   vm.openUpvalues = NULL;
+  vm.regionTop = vm.regionStart;
 }
 
 /**
@@ -33,8 +58,10 @@ static void resetStack()
  * @format: the format of the error.
  * Return: nothing.
  */
-static void runtimeError(const wchar_t *format, ...)
+void runtimeError(const wchar_t *format, ...)
 {
+  flushOutput();
+
   va_list args;
   va_start(args, format);
   vfwprintf(stderr, format, args);
@@ -55,17 +82,24 @@ static void runtimeError(const wchar_t *format, ...)
     }
     else
     {
-      fwprintf(stderr, L"%ls() ውስጥ\n", function->name->chars);
+      fwprintf(stderr, L"%.*ls() ውስጥ\n", function->name->length, function->name->chars);
     }
   }
 
   resetStack();
 }
 
-static void defineNative(const wchar_t *name, NativeFn function)
+/**
+ * defineNative - defines a global native function.
+ * @name: the name of the function.
+ * @arity: the number of arguments it takes, -1 for any number.
+ * @function: the C function.
+ * Return: nothing.
+ */
+void defineNative(const wchar_t *name, int arity, NativeFn function)
 {
   push(OBJ_VAL(copyString(name, wcslen(name))));
-  push(OBJ_VAL(newNative(function)));
+  push(OBJ_VAL(newNative(function, arity)));
   tableSet(&vm.globals, AS_STRING(vm.stack[0]), vm.stack[1]);
   pop();
   pop();
@@ -78,21 +112,24 @@ static void defineNative(const wchar_t *name, NativeFn function)
 void initVM()
 {
   resetStack();
-  vm.objects = NULL;
-  vm.bytesAllocated = 0;
-  vm.nextGC = 1024 * 1024;
-
-  vm.grayCount = 0;
-  vm.grayCapacity = 0;
-  vm.grayStack = NULL;
+  initCollector();
 
   initTable(&vm.globals);
   initTable(&vm.strings);
+  initTextBuffer(&vm.concatBuffer);
 
   vm.initString = NULL;
   vm.initString = copyString(L"ማስጀመሪያ", 6);
 
-  defineNative(L"ሰአት", clockNative);
+  defineNative(L"ሰአት", 0, clockNative);
+  defineNative(L"ቆሻሻ_ሰብስብ", 0, collectNative);
+  initIoNatives();
+  initTextNatives();
+  initEthiopicNatives();
+  initNumberNatives();
+  initStatsNatives();
+  initDumpNatives();
+  initWeakNatives();
 }
 
 /**
@@ -103,8 +140,11 @@ void freeVM()
 {
   freeTable(&vm.globals);
   freeTable(&vm.strings);
+  freeTextBuffer(&vm.concatBuffer);
   vm.initString = NULL;
   freeObjects();
+  freeProfile();
+  flushOutput();
 }
 
 /**
@@ -138,6 +178,52 @@ static Value peek(int distance)
   return vm.stackTop[-1 - distance];
 }
 
+/**
+ * leaveRegion - the heap copy of a region closure, for a callee that may
+ * keep it. the copy is made once and kept beside the closure, so passing
+ * it again gives the same object. the closure itself stays in the region,
+ * calling it does the same as calling the copy and its local still gives
+ * the region back when it goes out of scope.
+ * @closure: the closure.
+ * Return: the copy.
+ */
+static Value leaveRegion(ObjClosure *closure)
+{
+  Value *slot = regionCopy(closure);
+  if (!IS_NIL(*slot))
+    return *slot;
+
+  ObjClosure *copy = newClosure(closure->function);
+  for (int i = 0; i < closure->upvalueCount; i++)
+  {
+    copy->upvalues[i] = closure->upvalues[i];
+    writeBarrier((Obj *)copy, copy->upvalues[i]);
+  }
+  // the region is traced as a root, it needs no barrier.
+  *slot = OBJ_VAL(copy);
+  return *slot;
+}
+
+/**
+ * keepArguments - moves the region closures among the arguments of a call
+ * to the heap, except the ones passed to a parameter the callee only calls.
+ * @calledParams: the calledParams of the callee, 0 for a native.
+ * @argCount: the number of arguments.
+ * Return: nothing.
+ */
+static inline void keepArguments(uint32_t calledParams, int argCount)
+{
+  if (vm.regionTop == vm.regionStart)
+    return;
+  for (int i = 0; i < argCount; i++)
+  {
+    Value *arg = &vm.stackTop[i - argCount];
+    bool onlyCalled = i < CALLED_PARAMS_MAX && (calledParams >> i & 1);
+    if (!onlyCalled && IS_OBJ(*arg) && isRegion(AS_OBJ(*arg)))
+      *arg = leaveRegion(AS_CLOSURE(*arg));
+  }
+}
+
 static bool call(ObjClosure *closure, int argCount)
 {
   if (argCount != closure->function->arity)
@@ -151,10 +237,12 @@ static bool call(ObjClosure *closure, int argCount)
     runtimeError(L"Stack overflow.");
     return false;
   }
+  keepArguments(closure->function->calledParams, argCount);
   CallFrame *frame = &vm.frames[vm.frameCount++];
   frame->closure = closure;
   frame->ip = closure->function->chunk.code;
   frame->slots = vm.stackTop - argCount - 1;
+  frame->regionTop = vm.regionTop;
   return true;
 }
 
@@ -174,10 +262,9 @@ static bool callValue(Value callee, int argCount)
     {
       ObjClass *klass = AS_CLASS(callee);
       vm.stackTop[-argCount - 1] = OBJ_VAL(newInstance(klass));
-      Value initializer;
-      if (tableGet(&klass->methods, vm.initString, &initializer))
+      if (klass->initializer != NULL)
       {
-        return call(AS_CLOSURE(initializer), argCount);
+        return call(klass->initializer, argCount);
       }
       else if (argCount != 0)
       {
@@ -190,10 +277,16 @@ static bool callValue(Value callee, int argCount)
       return call(AS_CLOSURE(callee), argCount);
     case OBJ_NATIVE:
     {
-      NativeFn native = AS_NATIVE(callee);
-      Value result = native(argCount, vm.stackTop - argCount);
-      vm.stackTop -= argCount + 1;
-      push(result);
+      ObjNative *native = (ObjNative *)AS_OBJ(callee);
+      if (native->arity != -1 && argCount != native->arity)
+      {
+        runtimeError(L"%d የተግባር መለኪያዎች ተጠብቀው የተሰጡት ግን %d ነው።", native->arity, argCount);
+        return false;
+      }
+      keepArguments(0, argCount);
+      if (!native->function(argCount, vm.stackTop - argCount))
+        return false;
+      vm.stackTop -= argCount;
       return true;
     }
     default:
@@ -209,7 +302,7 @@ static bool invokeFromClass(ObjClass *klass, ObjString *name, int argCount)
   Value method;
   if (!tableGet(&klass->methods, name, &method))
   {
-    runtimeError(L"ያልተገለጸ አባል '%ls'.", name->chars);
+    runtimeError(L"ያልተገለጸ አባል '%.*ls'.", name->length, name->chars);
     return false;
   }
   return call(AS_CLOSURE(method), argCount);
@@ -238,7 +331,7 @@ static bool bindMethod(ObjClass *klass, ObjString *name)
   Value method;
   if (!tableGet(&klass->methods, name, &method))
   {
-    runtimeError(L"ያልተገለጸ አባል '%ls'.", name->chars);
+    runtimeError(L"ያልተገለጸ አባል '%.*ls'.", name->length, name->chars);
     return false;
   }
 
@@ -280,8 +373,11 @@ static void closeUpvalues(Value *last)
          vm.openUpvalues->location >= last)
   {
     ObjUpvalue *upvalue = vm.openUpvalues;
+    bool locked = lockHeap();
     upvalue->closed = *upvalue->location;
+    unlockHeap(locked);
     upvalue->location = &upvalue->closed;
+    writeBarrier((Obj *)upvalue, upvalue->closed);
     vm.openUpvalues = upvalue->next;
   }
 }
@@ -291,9 +387,31 @@ static void defineMethod(ObjString *name)
   Value method = peek(0);
   ObjClass *klass = AS_CLASS(peek(1));
   tableSet(&klass->methods, name, method);
+  writeBarrier((Obj *)klass, method);
+  if (name == vm.initString)
+  {
+    bool locked = lockHeap();
+    klass->initializer = AS_CLOSURE(method);
+    unlockHeap(locked);
+  }
   pop();
 }
 
+/**
+ * learnFieldCount - when an initializer returns, the class learns how many
+ * fields its instances end up with. only the last count is kept, an
+ * instance that once grew many fields does not make every later one big.
+ * @closure: the function that returns.
+ * @instance: the instance it returns.
+ * Return: nothing.
+ */
+static inline void learnFieldCount(ObjClosure *closure, ObjInstance *instance)
+{
+  ObjClass *klass = instance->klass;
+  if (closure == klass->initializer)
+    klass->fieldCount = instance->fields.count;
+}
+
 /**
  * valuesEqual - checks if two values are equal.
  * @a: the first value.
@@ -326,6 +444,38 @@ static void concatenate()
   push(OBJ_VAL(result));
 }
 
+/**
+ * concatenateN - joins the top count values into one string. strings are
+ * copied and other values formatted into a buffer the VM keeps between
+ * calls, so only the result string is allocated.
+ * @count: the number of values.
+ * Return: nothing.
+ */
+static void concatenateN(int count)
+{
+  TextBuffer *text = &vm.concatBuffer;
+  text->length = 0;
+  for (Value *value = vm.stackTop - count; value < vm.stackTop; value++)
+  {
+    appendValue(text, *value);
+  }
+
+  ObjString *result = copyString(text->length > 0 ? text->chars : L"", text->length);
+  vm.stackTop -= count;
+  push(OBJ_VAL(result));
+}
+
+/**
+ * heapLimitError - stops the program once the heap is past its limit,
+ * the garbage it leaves is freed by the next collection.
+ * Return: INTERPRET_RUNTIME_ERROR.
+ */
+static InterpretResult heapLimitError()
+{
+  runtimeError(L"ማህደረ ትውስታው ከተፈቀደው መጠን በላይ ሆኗል።");
+  return INTERPRET_RUNTIME_ERROR;
+}
+
 /**
  * run - runs the VM.
  * Return: INTERPRET_OK if successful.
@@ -341,6 +491,21 @@ static InterpretResult run()
 
 #define READ_STRING() AS_STRING(READ_CONSTANT())
 
+// objects only move at safepoints, before an instruction reads its operands.
+#define SAFEPOINT()                    \
+  do                                   \
+  {                                    \
+    if (vm.youngCollectionRequested)   \
+      collectYoung();                  \
+    if (vm.compactionRequested)        \
+      compactHeap();                   \
+    if (vm.heapExhausted &&            \
+        heapLimitReached())            \
+      return heapLimitError();         \
+    if (vm.heapDumpRequested)          \
+      dumpRequestedHeap();             \
+  } while (false)
+
 #define BINARY_OP(valueType, op)                    \
   do                                                \
   {                                                 \
@@ -407,7 +572,7 @@ static InterpretResult run()
       Value value;
       if (!tableGet(&vm.globals, name, &value))
       {
-        runtimeError(L"Undefined variable '%ls'.", name->chars);
+        runtimeError(L"Undefined variable '%.*ls'.", name->length, name->chars);
         return INTERPRET_RUNTIME_ERROR;
       }
       push(value);
@@ -426,7 +591,7 @@ static InterpretResult run()
       if (tableSet(&vm.globals, name, peek(0)))
       {
         tableDelete(&vm.globals, name);
-        runtimeError(L"Undefined variable '%ls'.", name->chars);
+        runtimeError(L"Undefined variable '%.*ls'.", name->length, name->chars);
         return INTERPRET_RUNTIME_ERROR;
       }
       break;
@@ -434,13 +599,22 @@ static InterpretResult run()
     case OP_GET_UPVALUE:
     {
       uint8_t slot = READ_BYTE();
-      push(*frame->closure->upvalues[slot]->location);
+      Value value = frame->closure->upvalues[slot];
+      if (IS_UPVALUE(value))
+        value = *AS_UPVALUE(value)->location;
+      push(value);
       break;
     }
     case OP_SET_UPVALUE:
     {
       uint8_t slot = READ_BYTE();
-      *frame->closure->upvalues[slot]->location = peek(0);
+      // only a variable that is assigned is written, it is always boxed.
+      ObjUpvalue *upvalue = AS_UPVALUE(frame->closure->upvalues[slot]);
+      // a closed upvalue is read by the background marker.
+      bool locked = lockHeap();
+      *upvalue->location = peek(0);
+      unlockHeap(locked);
+      writeBarrier((Obj *)upvalue, peek(0));
       break;
     }
     case OP_GET_PROPERTY:
@@ -475,6 +649,7 @@ static InterpretResult run()
       }
       ObjInstance *instance = AS_INSTANCE(peek(1));
       tableSet(&instance->fields, READ_STRING(), peek(0));
+      writeBarrier((Obj *)instance, peek(0));
       Value value = pop();
       pop();
       push(value);
@@ -520,6 +695,9 @@ static InterpretResult run()
         return INTERPRET_RUNTIME_ERROR;
       }
       break;
+    case OP_CONCAT_N:
+      concatenateN(READ_BYTE());
+      break;
     case OP_SUBTRACT:
       BINARY_OP(NUMBER_VAL, -);
       break;
@@ -543,7 +721,7 @@ static InterpretResult run()
     case OP_PRINT:
     {
       printValue(pop());
-      printf("\n");
+      endOutputLine();
       break;
     }
     case OP_JUMP:
@@ -561,12 +739,14 @@ static InterpretResult run()
     }
     case OP_LOOP:
     {
+      SAFEPOINT();
       uint16_t offset = READ_SHORT();
       frame->ip -= offset;
       break;
     }
     case OP_CALL:
     {
+      SAFEPOINT();
       int argCount = READ_BYTE();
       if (!callValue(peek(argCount), argCount))
       {
@@ -577,6 +757,7 @@ static InterpretResult run()
     }
     case OP_INVOKE:
     {
+      SAFEPOINT();
       ObjString *method = READ_STRING();
       int argCount = READ_BYTE();
       if (!invoke(method, argCount))
@@ -588,6 +769,7 @@ static InterpretResult run()
     }
     case OP_SUPER_INVOKE:
     {
+      SAFEPOINT();
       ObjString *method = READ_STRING();
       int argCount = READ_BYTE();
       ObjClass *superclass = AS_CLASS(pop());
@@ -599,22 +781,37 @@ static InterpretResult run()
       break;
     }
     case OP_CLOSURE:
+    case OP_REGION_CLOSURE:
     {
       ObjFunction *function = AS_FUNCTION(READ_CONSTANT());
-      ObjClosure *closure = newClosure(function);
+      ObjClosure *closure = NULL;
+      if (instruction == OP_REGION_CLOSURE)
+        closure = newRegionClosure(function);
+      // a full region falls back to the heap.
+      bool inRegion = closure != NULL;
+      if (!inRegion)
+        closure = newClosure(function);
       push(OBJ_VAL(closure));
       for (int i = 0; i < closure->upvalueCount; i++)
       {
-        uint8_t isLocal = READ_BYTE();
+        uint8_t capture = READ_BYTE();
         uint8_t index = READ_BYTE();
-        if (isLocal)
+        if (capture & CAPTURE_BOXED)
+        {
+          closure->upvalues[i] = OBJ_VAL(captureUpvalue(frame->slots + index));
+        }
+        else if (capture & CAPTURE_LOCAL)
         {
-          closure->upvalues[i] = captureUpvalue(frame->slots + index);
+          // a local function that calls itself finds itself on the top.
+          closure->upvalues[i] = frame->slots[index];
         }
         else
         {
           closure->upvalues[i] = frame->closure->upvalues[index];
         }
+        // the region is traced as a root, it needs no barrier.
+        if (!inRegion)
+          writeBarrier((Obj *)closure, closure->upvalues[i]);
       }
       break;
     }
@@ -622,10 +819,23 @@ static InterpretResult run()
       closeUpvalues(vm.stackTop - 1);
       pop();
       break;
+    case OP_POP_REGION:
+    {
+      // the region closures of the frame made after this one went out of
+      // scope before it.
+      Obj *closure = AS_OBJ(pop());
+      if (isRegion(closure))
+        vm.regionTop = (uint8_t *)closure;
+      break;
+    }
     case OP_RETURN:
     {
+      SAFEPOINT();
       Value result = pop();
+      if (IS_INSTANCE(result))
+        learnFieldCount(frame->closure, AS_INSTANCE(result));
       closeUpvalues(frame->slots);
+      vm.regionTop = frame->regionTop;
       vm.frameCount--;
       if (vm.frameCount == 0)
       {
@@ -648,6 +858,10 @@ static InterpretResult run()
       }
       ObjClass *subclass = AS_CLASS(peek(0));
       tableAddAll(&AS_CLASS(superclass)->methods, &subclass->methods);
+      bool locked = lockHeap();
+      subclass->initializer = AS_CLASS(superclass)->initializer;
+      unlockHeap(locked);
+      writeBarrierAll((Obj *)subclass);
       pop(); // Subclass.
       break;
     }
@@ -663,6 +877,7 @@ static InterpretResult run()
 #undef READ_SHORT
 #undef READ_CONSTANT
 #undef READ_STRING
+#undef SAFEPOINT
 #undef BINARY_OP
 }
 
@@ -1,6 +1,7 @@
 #ifndef AHADU_VM_H
 #define AHADU_VM_H
 
+#include <signal.h>
 #include <wctype.h>
 #include <wchar.h>
 
@@ -15,8 +16,49 @@ typedef struct {
   ObjClosure *closure;
   uint8_t *ip;
   Value *slots;
+  uint8_t *regionTop; // the top of the region when the frame was entered.
 } CallFrame;
 
+/**
+ * GcPhase - what the old generation collector is doing.
+ * GC_IDLE: no cycle is running.
+ * GC_MARKING: a cycle is marking in steps between allocations.
+ * GC_SWEEPING: the dead objects of a cycle are freed in steps.
+ */
+typedef enum {
+  GC_IDLE,
+  GC_MARKING,
+  GC_SWEEPING,
+} GcPhase;
+
+// the pause histogram has a bucket for each power of two microseconds.
+#define GC_PAUSE_BUCKETS 20
+
+/**
+ * GcStats - the counters of the collector, they are always kept.
+ * @pauses: the number of pauses.
+ * @pauseTotal: the sum of the pauses in nanoseconds.
+ * @pauseMax: the longest pause in nanoseconds.
+ * @pauseHistogram: bucket 0 counts the pauses shorter than a microsecond,
+ *                  bucket i the ones shorter than 2^i microseconds that are
+ *                  not in bucket i - 1. the last bucket counts the rest.
+ * @youngCollections: the number of young collections.
+ * @cycles: the number of cycles of the old generation that finished.
+ * @compactions: the number of times the heap was compacted.
+ * @freedBytes: the bytes of the objects the collector freed, with the
+ *              memory they owned.
+ */
+typedef struct {
+  size_t pauses;
+  uint64_t pauseTotal;
+  uint64_t pauseMax;
+  size_t pauseHistogram[GC_PAUSE_BUCKETS];
+  size_t youngCollections;
+  size_t cycles;
+  size_t compactions;
+  size_t freedBytes;
+} GcStats;
+
 /**
  * @chunk: the chunk that the vm executs
  * @ip: the location of the current instruction.
@@ -34,11 +76,44 @@ typedef struct {
   
   size_t bytesAllocated;
   size_t nextGC;
+  size_t largeBytes;  // the bytes of the blocks in the large object space.
+  size_t nextLargeGC;
+  size_t nextStep;
+  size_t cycleStart;
+  GcPhase gcPhase;
+  uint64_t gcPauseBudget; // nanoseconds a marking step may take.
+  bool gcConcurrent;      // marking runs on a background thread.
+  bool gcCompact;         // a fragmented heap is compacted after a cycle.
+  double gcGrowthFactor;  // how much the heap may grow between cycles.
+  size_t gcMinHeap;       // the smallest heap a cycle starts at.
+  size_t gcMaxHeap;       // the heap limit, 0 when there is none.
+  bool heapExhausted;     // the heap is past its limit after a collection.
+  GcStats gcStats;
+  size_t profileCountdown; // bytes to the next allocation sample, 0 when off.
+  volatile sig_atomic_t heapDumpRequested; // set by SIGUSR1.
 
-  Obj *objects;
+  uint8_t *nurseryStart;
+  uint8_t *nurseryTop;
+  uint8_t *nurseryEnd;
+  uint64_t *nurseryMarks; // the mark bits of the young objects.
+  // the closures the compiler proved do not outlive their frame, freed
+  // when the frame returns or their local goes out of scope.
+  uint8_t *regionStart;
+  uint8_t *regionTop;
+  uint8_t *regionEnd;
+  bool youngCollectionRequested;
+  bool compactionRequested;
+  int rememberedCount;
+  int rememberedCapacity;
+  Obj **remembered;
+  int promotedCount;
+  int promotedCapacity;
+  Obj **promoted;
   int grayCount;
   int grayCapacity;
   Obj **grayStack;
+
+  TextBuffer concatBuffer;
 } VM;
 
 /**
@@ -57,5 +132,7 @@ void freeVM();
 InterpretResult interpret(const wchar_t *source);
 void push(Value value);
 Value pop();
+void runtimeError(const wchar_t *format, ...);
+void defineNative(const wchar_t *name, int arity, NativeFn function);
 
 #endif
@@ -0,0 +1,299 @@
+#include <stdlib.h>
+
+#include "memory.h"
+#include "object.h"
+#include "vm.h"
+#include "weak.h"
+
+#define WEAK_MAP_MAX_LOAD 0.75
+
+/**
+ * hashObject - the hash of a key, from its address.
+ * @object: the key.
+ * Return: the hash.
+ */
+static inline uint32_t hashObject(Obj *object)
+{
+  // objects are 8 byte aligned, the multiply spreads the other bits.
+  return (uint32_t)((((uintptr_t)object >> 3) * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+/**
+ * findWeakEntry - finds the slot of a key, or the empty slot where it
+ * goes. there has to be an empty slot.
+ * @entries: the slots.
+ * @capacity: the number of slots, a power of two.
+ * @key: the key.
+ * Return: the slot.
+ */
+static WeakEntry *findWeakEntry(WeakEntry *entries, int capacity, Obj *key)
+{
+  uint32_t mask = (uint32_t)capacity - 1;
+  uint32_t index = hashObject(key) & mask;
+  for (;;)
+  {
+    WeakEntry *entry = &entries[index];
+    if (entry->key == key || entry->key == NULL)
+      return entry;
+    index = (index + 1) & mask;
+  }
+}
+
+/**
+ * weakMapGet - looks up the value of a key.
+ * @map: the map.
+ * @key: the key.
+ * @value: where the value is put.
+ * Return: true if the key is in the map.
+ */
+bool weakMapGet(ObjWeakMap *map, Obj *key, Value *value)
+{
+  if (map->count == 0)
+    return false;
+  WeakEntry *entry = findWeakEntry(map->entries, map->capacity, key);
+  if (entry->key == NULL)
+    return false;
+  *value = entry->value;
+  return true;
+}
+
+/**
+ * weakMapSet - sets the value of a key. growing the slots may run the
+ * collector, the key and the value have to be reachable.
+ * @map: the map, it has to be reachable.
+ * @key: the key.
+ * @value: the value.
+ * Return: nothing.
+ */
+void weakMapSet(ObjWeakMap *map, Obj *key, Value value)
+{
+  if (map->count + 1 > map->capacity * WEAK_MAP_MAX_LOAD)
+  {
+    int capacity = GROW_CAPACITY(map->capacity);
+    WeakEntry *entries = ALLOCATE(WeakEntry, capacity);
+    for (int i = 0; i < capacity; i++)
+    {
+      entries[i].key = NULL;
+      entries[i].value = NIL_VAL;
+    }
+
+    // the collection the allocation ran may have dropped entries.
+    for (int i = 0; i < map->capacity; i++)
+    {
+      WeakEntry *entry = &map->entries[i];
+      if (entry->key != NULL)
+        *findWeakEntry(entries, capacity, entry->key) = *entry;
+    }
+    FREE_ARRAY(WeakEntry, map->entries, map->capacity);
+    map->entries = entries;
+    map->capacity = capacity;
+  }
+
+  WeakEntry *entry = findWeakEntry(map->entries, map->capacity, key);
+  if (entry->key == NULL)
+    map->count++;
+  entry->key = key;
+  entry->value = value;
+}
+
+/**
+ * removeSlot - empties a slot and moves the entries after it back, so that
+ * no entry is past an empty slot from where it hashes to.
+ * @map: the map.
+ * @hole: the index of the slot.
+ * Return: nothing.
+ */
+static void removeSlot(ObjWeakMap *map, uint32_t hole)
+{
+  uint32_t mask = (uint32_t)map->capacity - 1;
+  for (uint32_t next = (hole + 1) & mask; map->entries[next].key != NULL; next = (next + 1) & mask)
+  {
+    uint32_t home = hashObject(map->entries[next].key) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask))
+    {
+      map->entries[hole] = map->entries[next];
+      hole = next;
+    }
+  }
+  map->entries[hole].key = NULL;
+  map->entries[hole].value = NIL_VAL;
+  map->count--;
+}
+
+/**
+ * weakMapDelete - removes a key.
+ * @map: the map.
+ * @key: the key.
+ * Return: true if the key was in the map.
+ */
+bool weakMapDelete(ObjWeakMap *map, Obj *key)
+{
+  if (map->count == 0)
+    return false;
+  WeakEntry *entry = findWeakEntry(map->entries, map->capacity, key);
+  if (entry->key == NULL)
+    return false;
+  removeSlot(map, (uint32_t)(entry - map->entries));
+  return true;
+}
+
+/**
+ * rehashWeakMap - updates the entries of a map after a collection: the
+ * entries whose key died are dropped, the others go to the slot of the
+ * new place of their key. it runs inside the collector, so it does not
+ * allocate from the heap.
+ * @map: the map.
+ * @move: gives the new place of an object, NULL for one that died. the
+ * values of the entries that stay have to be alive.
+ * Return: nothing.
+ */
+void rehashWeakMap(ObjWeakMap *map, MoveFn move)
+{
+  if (map->count == 0)
+    return;
+
+  WeakEntry *live = (WeakEntry *)malloc(sizeof(WeakEntry) * map->count);
+  if (live == NULL)
+    exit(1);
+  int count = 0;
+  for (int i = 0; i < map->capacity; i++)
+  {
+    WeakEntry *entry = &map->entries[i];
+    if (entry->key == NULL)
+      continue;
+    Obj *key = move(entry->key);
+    if (key != NULL)
+    {
+      live[count].key = key;
+      live[count].value = IS_OBJ(entry->value) ? OBJ_VAL(move(AS_OBJ(entry->value)))
+                                               : entry->value;
+      count++;
+    }
+    entry->key = NULL;
+    entry->value = NIL_VAL;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    *findWeakEntry(map->entries, map->capacity, live[i].key) = live[i];
+  }
+  map->count = count;
+  free(live);
+}
+
+/**
+ * weakBarrier - the write barrier for a weak object. a weak slot is not
+ * traced, so a marked owner does not gray what is stored in it, the
+ * collector looks at the slots once marking is done. an old owner is
+ * still remembered, a young collection has to update the slot.
+ * @owner: the weak ref or weak map written to.
+ * @value: the value written.
+ * Return: nothing.
+ */
+static void weakBarrier(Obj *owner, Value value)
+{
+  if (IS_OBJ(value) && isYoung(AS_OBJ(value)))
+    rememberObject(owner);
+}
+
+static bool weakRefNative(int argCount, Value *args)
+{
+  args[-1] = OBJ_VAL(newWeakRef(args[0]));
+  return true;
+}
+
+static bool weakRefGetNative(int argCount, Value *args)
+{
+  if (!IS_WEAK_REF(args[0]))
+  {
+    runtimeError(L"ደካማ ማጣቀሻ ያስፈልጋል።");
+    return false;
+  }
+  args[-1] = AS_WEAK_REF(args[0])->target;
+  return true;
+}
+
+static bool weakMapNative(int argCount, Value *args)
+{
+  args[-1] = OBJ_VAL(newWeakMap());
+  return true;
+}
+
+/**
+ * checkWeakMap - checks the map and the key of a weak map native.
+ * @args: the arguments, the map and the key.
+ * @name: the name of the native.
+ * Return: true if they are a weak map and an object.
+ */
+static bool checkWeakMap(Value *args, const wchar_t *name)
+{
+  if (!IS_WEAK_MAP(args[0]))
+  {
+    runtimeError(L"%ls ደካማ ካርታ ያስፈልገዋል።", name);
+    return false;
+  }
+  if (!IS_OBJ(args[1]))
+  {
+    runtimeError(L"የደካማ ካርታ ቁልፍ ነገር መሆን አለበት።");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * weakMapSetNative - sets the value of a key of a weak map.
+ * @args: the map, the key and the value.
+ * Return: false if the map or the key is wrong.
+ */
+static bool weakMapSetNative(int argCount, Value *args)
+{
+  if (!checkWeakMap(args, L"ካርታ_አስቀምጥ"))
+    return false;
+  ObjWeakMap *map = AS_WEAK_MAP(args[0]);
+  weakMapSet(map, AS_OBJ(args[1]), args[2]);
+  weakBarrier((Obj *)map, args[1]);
+  weakBarrier((Obj *)map, args[2]);
+  args[-1] = args[2];
+  return true;
+}
+
+static bool weakMapGetNative(int argCount, Value *args)
+{
+  if (!checkWeakMap(args, L"ካርታ_አግኝ"))
+    return false;
+  if (!weakMapGet(AS_WEAK_MAP(args[0]), AS_OBJ(args[1]), &args[-1]))
+    args[-1] = NIL_VAL;
+  return true;
+}
+
+static bool weakMapHasNative(int argCount, Value *args)
+{
+  if (!checkWeakMap(args, L"ካርታ_ይዟል"))
+    return false;
+  Value value;
+  args[-1] = BOOL_VAL(weakMapGet(AS_WEAK_MAP(args[0]), AS_OBJ(args[1]), &value));
+  return true;
+}
+
+static bool weakMapDeleteNative(int argCount, Value *args)
+{
+  if (!checkWeakMap(args, L"ካርታ_አስወግድ"))
+    return false;
+  args[-1] = BOOL_VAL(weakMapDelete(AS_WEAK_MAP(args[0]), AS_OBJ(args[1])));
+  return true;
+}
+
+/**
+ * initWeakNatives - defines the natives of weak refs and weak maps.
+ * Return: nothing.
+ */
+void initWeakNatives()
+{
+  defineNative(L"ደካማ_ማጣቀሻ", 1, weakRefNative);
+  defineNative(L"ማጣቀሻ_አግኝ", 1, weakRefGetNative);
+  defineNative(L"ደካማ_ካርታ", 0, weakMapNative);
+  defineNative(L"ካርታ_አስቀምጥ", 3, weakMapSetNative);
+  defineNative(L"ካርታ_አግኝ", 2, weakMapGetNative);
+  defineNative(L"ካርታ_ይዟል", 2, weakMapHasNative);
+  defineNative(L"ካርታ_አስወግድ", 2, weakMapDeleteNative);
+}
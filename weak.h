@@ -0,0 +1,14 @@
+#ifndef AHADU_WEAK_H
+#define AHADU_WEAK_H
+
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+
+bool weakMapGet(ObjWeakMap *map, Obj *key, Value *value);
+void weakMapSet(ObjWeakMap *map, Obj *key, Value value);
+bool weakMapDelete(ObjWeakMap *map, Obj *key);
+void rehashWeakMap(ObjWeakMap *map, MoveFn move);
+void initWeakNatives();
+
+#endif // !AHADU_WEAK_H